@@ -0,0 +1,70 @@
+// Measures --args-from throughput: writes a file of NUL-delimited arguments,
+// then parses it with a listener that only looks at the values.
+
+#include <aa.hpp>
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+int main(int argc, char* argv[])
+{
+    auto megabytes = aa::opt<int>("-m", "--megabytes")
+        .metavar("N")
+        .init(256)
+        .help("size of the generated argument file");
+    auto repeat = aa::opt<int>("-r", "--repeat")
+        .metavar("N")
+        .init(5)
+        .help("number of timed runs");
+    auto path = aa::opt<std::string>("-o", "--output")
+        .metavar("FILE")
+        .init("args_from.bench")
+        .help("where to write the argument file");
+    aa::parse(argc, argv);
+
+    size_t fileSize = 0;
+    {
+        auto file = std::ofstream{*path, std::ios::binary};
+        auto chunk = std::string{};
+        for (int i = 0; chunk.size() < (1 << 20); i++) {
+            chunk += "--include=src/module" + std::to_string(i) + "/*.cpp";
+            chunk += '\0';
+            chunk += "positional-argument-" + std::to_string(i * 7);
+            chunk += '\0';
+        }
+        while (fileSize < size_t(*megabytes) << 20) {
+            file.write(chunk.data(), chunk.size());
+            fileSize += chunk.size();
+        }
+    }
+
+    double best = 0;
+    for (int run = 0; run < repeat; run++) {
+        auto parser = aa::Parser{};
+        parser.opt<std::string>("--include");
+        parser.argsFrom();
+
+        size_t checksum = 0;
+        parser.listen([&checksum] (const aa::Event& event) {
+            checksum += event.value.size;
+        });
+
+        auto start = std::chrono::steady_clock::now();
+        parser.parse(std::vector<std::string>{"-0", "--args-from", *path});
+        auto seconds = std::chrono::duration<double>(
+            std::chrono::steady_clock::now() - start).count();
+
+        double gbps = fileSize / seconds / 1e9;
+        best = gbps > best ? gbps : best;
+        std::cout << "run " << run << ": " << fileSize << " bytes in " <<
+            seconds << " s, " << gbps << " GB/s (checksum " << checksum <<
+            ")\n";
+    }
+    std::cout << "best: " << best << " GB/s\n";
+
+    std::remove(path->c_str());
+}
@@ -0,0 +1,110 @@
+// Measures how long it takes to compile a translation unit that includes each
+// of aa's public headers, by running the compiler on generated files.
+//
+//   compile_time -c "g++ -std=c++20 -Isrc/include"
+//
+// aa/fwd.hpp and aa/options.hpp are meant to stay light, and aa.hpp to cost
+// little more than the standard headers it needs. Each has a budget, a
+// multiple of the time taken by a translation unit with only such standard
+// headers, and the run fails when one goes over it. Comparing with these
+// rather than with fixed times keeps the budgets meaningful across machines.
+// They are set for C++17 and later, where the standard headers weigh more
+// than in C++11; use --no-budget for other setups.
+
+#include <aa.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+int main(int argc, char* argv[])
+{
+    auto compiler = aa::opt<std::string>("-c", "--compiler")
+        .metavar("COMMAND")
+        .init("c++ -std=c++20")
+        .help("compiler and flags, including -I for aa's headers");
+    auto repeat = aa::opt<int>("-r", "--repeat")
+        .metavar("N")
+        .init(5)
+        .help("compilations per header, of which the fastest counts");
+    auto directory = aa::opt<std::string>("-d", "--directory")
+        .metavar("DIR")
+        .init(".")
+        .help("where to write the generated sources");
+    auto noBudget = aa::flag("--no-budget")
+        .help("only report times, without failing on budgets");
+    aa::parse(argc, argv);
+
+    // Headers with a budget are compared with a case of their own that
+    // includes only standard headers they use anyway.
+    struct Case {
+        const char* name;
+        const char* source;
+        // The case the budget is a multiple of, and the budget, or -1 and 0.
+        int reference;
+        double budget;
+    };
+    const auto cases = std::vector<Case>{
+        {"(empty)", "int main() {}\n", -1, 0},
+        {"(std core)",
+            "#include <atomic>\n#include <memory>\n"
+            "#include <string>\n#include <vector>\n", -1, 0},
+        {"(std all)",
+            "#include <algorithm>\n#include <chrono>\n#include <cmath>\n"
+            "#include <condition_variable>\n#include <deque>\n"
+            "#include <fstream>\n#include <functional>\n#include <map>\n"
+            "#include <memory>\n#include <mutex>\n#include <set>\n"
+            "#include <sstream>\n#include <string>\n#include <thread>\n"
+            "#include <unordered_map>\n#include <unordered_set>\n"
+            "#include <vector>\n", -1, 0},
+        {"aa/fwd.hpp",
+            "#include <aa/fwd.hpp>\nint f(const aa::Option<int>&);\n", 1, 0.2},
+        {"aa/options.hpp",
+            "#include <aa/options.hpp>\n"
+            "int f(const aa::Option<int>& o) { return *o; }\n", 1, 1.75},
+        {"aa.hpp",
+            "#include <aa.hpp>\n"
+            "int main(int c, char** v) { auto o = aa::opt<int>(\"-n\");"
+            " aa::parse(c, v); return *o; }\n", 2, 3},
+    };
+
+    auto times = std::vector<double>{};
+    auto overBudget = 0;
+    std::printf("%-16s %10s %10s\n", "header", "ms per TU", "budget");
+    for (const auto& c : cases) {
+        auto path = *directory + "/compile_time.cpp";
+        std::ofstream{path} << c.source;
+        auto command = *compiler + " -fsyntax-only " + path;
+
+        // The fastest run, which noise from other processes affects least.
+        auto ms = 0.0;
+        for (int i = 0; i < *repeat; i++) {
+            auto start = std::chrono::steady_clock::now();
+            if (std::system(command.c_str()) != 0) {
+                std::cerr << "failed: " << command << "\n";
+                return 1;
+            }
+            auto elapsed = std::chrono::duration<double, std::milli>(
+                std::chrono::steady_clock::now() - start).count();
+            ms = i == 0 ? elapsed : std::min(ms, elapsed);
+        }
+        std::remove(path.c_str());
+        times.push_back(ms);
+
+        if (c.reference < 0) {
+            std::printf("%-16s %10.0f\n", c.name, ms);
+            continue;
+        }
+        auto budget = c.budget * times[c.reference];
+        bool over = ms > budget;
+        std::printf("%-16s %10.0f %10.0f%s\n",
+            c.name, ms, budget, over ? "  over budget" : "");
+        overBudget += over;
+    }
+    return overBudget > 0 && !noBudget ? 1 : 0;
+}
@@ -0,0 +1,51 @@
+// Measures exec-to-exit time of the given programs, which is dominated by
+// process creation, dynamic linking and static initialization:
+//
+//   startup -p startup_empty -p startup_static -p startup_dynamic
+
+#include <aa.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <string>
+
+#include <spawn.h>
+#include <sys/wait.h>
+
+extern char** environ;
+
+int main(int argc, char* argv[])
+{
+    auto repeat = aa::opt<int>("-r", "--repeat")
+        .metavar("N")
+        .init(2000)
+        .help("number of runs per program");
+    auto programs = aa::opt<std::string>("-p", "--program")
+        .metavar("PATH")
+        .help("program to run; may be given several times");
+    aa::parse(argc, argv);
+
+    std::printf("%-24s %10s %10s\n", "program", "mean us", "min us");
+    for (const auto& program : programs.all()) {
+        char* args[] = {const_cast<char*>(program.c_str()), nullptr};
+        auto total = std::chrono::steady_clock::duration{0};
+        auto best = std::chrono::steady_clock::duration::max();
+        for (int i = 0; i < repeat; i++) {
+            auto start = std::chrono::steady_clock::now();
+            pid_t pid;
+            if (posix_spawn(&pid, args[0], nullptr, nullptr, args, environ)) {
+                std::perror(args[0]);
+                return 1;
+            }
+            int status = 0;
+            waitpid(pid, &status, 0);
+            auto time = std::chrono::steady_clock::now() - start;
+            total += time;
+            best = std::min(best, time);
+        }
+        using Micro = std::chrono::duration<double, std::micro>;
+        std::printf("%-24s %10.1f %10.1f\n", program.c_str(),
+            Micro(total).count() / repeat, Micro(best).count());
+    }
+}
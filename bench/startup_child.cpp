@@ -0,0 +1,43 @@
+// A program with 16 options that exits without parsing unless given
+// arguments, for the startup benchmark. Built three ways: without options
+// (AA_STARTUP_EMPTY), with static declarations (AA_STARTUP_STATIC), and with
+// aa::opt() at namespace scope.
+
+#include <string>
+
+#if !defined(AA_STARTUP_EMPTY)
+
+#include <aa.hpp>
+
+#define AA_STARTUP_OPTIONS(X) \
+    X(a) X(b) X(c) X(d) X(e) X(f) X(g) X(h) \
+    X(i) X(j) X(k) X(l) X(m) X(n) X(o) X(p)
+
+#if defined(AA_STARTUP_STATIC)
+#define AA_STARTUP_DECLARE(name) \
+    AA_CONSTINIT aa::StaticOption<std::string> name{"--" #name};
+#define AA_STARTUP_NAME(name) , name
+#else
+#define AA_STARTUP_DECLARE(name) \
+    auto name = aa::opt<std::string>("--" #name);
+#endif
+
+AA_STARTUP_OPTIONS(AA_STARTUP_DECLARE)
+
+#endif
+
+int main(int argc, char* argv[])
+{
+#if defined(AA_STARTUP_STATIC)
+    if (argc > 1) {
+        aa::parse(argc, argv AA_STARTUP_OPTIONS(AA_STARTUP_NAME));
+    }
+#elif !defined(AA_STARTUP_EMPTY)
+    if (argc > 1) {
+        aa::parse(argc, argv);
+    }
+#else
+    // Links the C++ runtime, like the other two.
+    return static_cast<int>(std::string(argv[0]).size()) * (argc - 1);
+#endif
+}
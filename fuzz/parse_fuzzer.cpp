@@ -0,0 +1,151 @@
+// Fuzz target for tokenizing and dispatch. The input is a command line with
+// arguments separated by NUL characters. It is parsed in every way the
+// parser can read a command line, and the results must agree:
+//
+// - parse(), converting each value as it is read;
+// - parse() with every value collected and converted in bulk;
+// - track(), which classifies each argument on its own;
+// - parse() of the command line argv() renders from a successful parse.
+//
+// Any difference, and any exception but aa::ParseError, aborts.
+
+#include <aa.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+namespace {
+
+const size_t maxArgs = 64;
+
+void declare(aa::Parser& parser)
+{
+    auto verbose = parser.flag("-v", "--verbose");
+    auto quiet = parser.flag("-q", "--quiet");
+    parser.opt<int>("-l", "--level");
+    parser.opt<std::string>("-n", "--name").keepLast();
+    parser.opt<aa::bytes>("-s", "--size");
+    parser.opt<aa::duration>("-t", "--timeout");
+    parser.opt<std::string>("-i", "--input").nonEmpty();
+    parser.opt<int>("-m", "--mode").choices({{"fast", 1}, {"safe", 2}});
+    parser.exclusive(verbose, quiet);
+    parser.occurrences(verbose, 0, 3);
+    parser.printErrors(false);
+}
+
+std::vector<std::string> split(const std::uint8_t* data, size_t size)
+{
+    auto args = std::vector<std::string>{};
+    auto begin = reinterpret_cast<const char*>(data);
+    auto end = begin + size;
+    while (begin < end && args.size() < maxArgs) {
+        auto nul = std::find(begin, end, '\0');
+        args.emplace_back(begin, nul);
+        begin = nul + 1;
+    }
+    return args;
+}
+
+// What a parse left: the rendered command line, or the sorted problems.
+struct Outcome {
+    bool failed = false;
+    std::vector<std::string> lines;
+};
+
+std::vector<std::string> render(const aa::Parser& parser)
+{
+    auto argv = parser.argv();
+    return std::vector<std::string>(argv.argv(), argv.argv() + argv.argc());
+}
+
+Outcome parse(const std::vector<std::string>& args, bool bulk)
+{
+    auto parser = aa::Parser{};
+    declare(parser);
+    if (bulk) {
+        parser.parallelConversion(0, 3);
+    }
+    auto outcome = Outcome{};
+    try {
+        parser.parse(args);
+        outcome.lines = render(parser);
+    } catch (const aa::ParseError& error) {
+        outcome.failed = true;
+        for (const auto& diagnostic : error.diagnostics()) {
+            outcome.lines.push_back(diagnostic.message());
+        }
+        std::sort(outcome.lines.begin(), outcome.lines.end());
+    }
+    return outcome;
+}
+
+Outcome track(const std::vector<std::string>& args)
+{
+    auto parser = aa::Parser{};
+    declare(parser);
+    auto errors = parser.track(args);
+    auto outcome = Outcome{};
+    if (errors.empty()) {
+        outcome.lines = render(parser);
+        return outcome;
+    }
+    outcome.failed = true;
+    size_t begin = 0;
+    while (begin < errors.size()) {
+        auto end = errors.find('\n', begin);
+        outcome.lines.push_back(errors.substr(begin, end - begin));
+        begin = end + 1;
+    }
+    std::sort(outcome.lines.begin(), outcome.lines.end());
+    return outcome;
+}
+
+void print(const char* name, const Outcome& outcome)
+{
+    std::fprintf(stderr, "%s (%s):\n", name,
+        outcome.failed ? "failed" : "parsed");
+    for (const auto& line : outcome.lines) {
+        std::fprintf(stderr, "  [%s]\n", line.c_str());
+    }
+}
+
+void expectSame(
+    const std::vector<std::string>& args,
+    const char* name, const Outcome& expected,
+    const char* otherName, const Outcome& other)
+{
+    if (expected.failed == other.failed && expected.lines == other.lines) {
+        return;
+    }
+    std::fprintf(stderr, "mismatch for:\n");
+    for (const auto& arg : args) {
+        std::fprintf(stderr, "  [%s]\n", arg.c_str());
+    }
+    print(name, expected);
+    print(otherName, other);
+    std::abort();
+}
+
+} // namespace
+
+extern "C" int LLVMFuzzerTestOneInput(const std::uint8_t* data, size_t size)
+{
+    auto args = split(data, size);
+
+    auto direct = parse(args, false);
+    expectSame(args, "parse", direct, "bulk", parse(args, true));
+    expectSame(args, "parse", direct, "track", track(args));
+
+    if (!direct.failed) {
+        auto rendered = std::vector<std::string>(
+            direct.lines.begin() + 1, direct.lines.end());
+        expectSame(
+            args, "parse", direct, "reparse", parse(rendered, false));
+    }
+    return 0;
+}
@@ -0,0 +1,135 @@
+// Runs the fuzz target over its corpus without libFuzzer, and reports how
+// many inputs it gets through per second, so that changes to the tokenizer
+// can be checked for equivalence and speed with any compiler. Random command
+// lines built from the tokens of the seeds can be added to the corpus.
+
+#include <aa.hpp>
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include <dirent.h>
+
+extern "C" int LLVMFuzzerTestOneInput(const std::uint8_t* data, size_t size);
+
+namespace {
+
+std::vector<std::string> readCorpus(const std::string& directory)
+{
+    auto inputs = std::vector<std::string>{};
+    DIR* dir = opendir(directory.c_str());
+    if (dir == nullptr) {
+        std::fprintf(stderr, "cannot open %s\n", directory.c_str());
+        return inputs;
+    }
+    auto names = std::vector<std::string>{};
+    while (auto entry = readdir(dir)) {
+        if (entry->d_name[0] != '.') {
+            names.push_back(directory + "/" + entry->d_name);
+        }
+    }
+    closedir(dir);
+
+    for (const auto& name : names) {
+        auto file = std::ifstream{name, std::ios::binary};
+        inputs.emplace_back(
+            std::istreambuf_iterator<char>{file},
+            std::istreambuf_iterator<char>{});
+    }
+    return inputs;
+}
+
+// Command lines of up to 12 arguments taken from the seeds.
+std::vector<std::string> randomInputs(
+    const std::vector<std::string>& seeds, int count, std::uint32_t random)
+{
+    auto tokens = std::vector<std::string>{};
+    for (const auto& seed : seeds) {
+        size_t begin = 0;
+        while (begin <= seed.size()) {
+            auto end = seed.find('\0', begin);
+            if (end == std::string::npos) {
+                end = seed.size();
+            }
+            tokens.push_back(seed.substr(begin, end - begin));
+            begin = end + 1;
+        }
+    }
+    auto next = [&random] (std::uint32_t n) {
+        random = random * 1103515245 + 12345;
+        return (random >> 16) % n;
+    };
+
+    auto inputs = std::vector<std::string>{};
+    if (tokens.empty()) {
+        return inputs;
+    }
+    for (int i = 0; i < count; i++) {
+        auto input = std::string{};
+        auto args = next(13);
+        for (std::uint32_t j = 0; j < args; j++) {
+            if (j > 0) {
+                input += '\0';
+            }
+            input += tokens[next(static_cast<std::uint32_t>(tokens.size()))];
+        }
+        inputs.push_back(std::move(input));
+    }
+    return inputs;
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    auto corpus = aa::opt<std::string>("-c", "--corpus")
+        .metavar("DIR")
+        .init("corpus")
+        .help("directory of inputs, one command line per file");
+    auto random = aa::opt<int>("-r", "--random")
+        .metavar("N")
+        .init(10000)
+        .help("number of random command lines to add");
+    auto seed = aa::opt<int>("--seed")
+        .metavar("N")
+        .init(1)
+        .help("seed for the random command lines");
+    auto repeat = aa::opt<int>("-n", "--repeat")
+        .metavar("N")
+        .init(5)
+        .help("number of timed runs over all inputs");
+    aa::parse(argc, argv);
+
+    auto inputs = readCorpus(*corpus);
+    auto seeds = inputs.size();
+    auto extra = randomInputs(
+        inputs, *random, static_cast<std::uint32_t>(*seed));
+    inputs.insert(inputs.end(), extra.begin(), extra.end());
+    if (inputs.empty()) {
+        return 1;
+    }
+
+    double best = 0;
+    for (int run = 0; run < *repeat; run++) {
+        auto start = std::chrono::steady_clock::now();
+        for (const auto& input : inputs) {
+            LLVMFuzzerTestOneInput(
+                reinterpret_cast<const std::uint8_t*>(input.data()),
+                input.size());
+        }
+        auto seconds = std::chrono::duration<double>(
+            std::chrono::steady_clock::now() - start).count();
+        auto rate = static_cast<double>(inputs.size()) / seconds;
+        best = rate > best ? rate : best;
+    }
+
+    std::printf("%zu inputs (%zu seeds), all equivalent\n",
+        inputs.size(), seeds);
+    std::printf("best of %d runs: %.0f execs/s\n", *repeat, best);
+    return 0;
+}
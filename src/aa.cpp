@@ -0,0 +1,19 @@
+// The aa_compiled library: Parser's members and the common option types,
+// compiled once. Everything linking it must define AA_COMPILED.
+
+#include <aa.hpp>
+#include <aa/parser_impl.hpp>
+
+namespace aa {
+
+template struct TypedOptionData<int>;
+template struct TypedOptionData<long>;
+template struct TypedOptionData<long long>;
+template struct TypedOptionData<unsigned>;
+template struct TypedOptionData<unsigned long>;
+template struct TypedOptionData<unsigned long long>;
+template struct TypedOptionData<float>;
+template struct TypedOptionData<double>;
+template struct TypedOptionData<std::string>;
+
+} // namespace aa
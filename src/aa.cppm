@@ -0,0 +1,46 @@
+// C++20 module interface for aa. Built only when requested; see
+// AA_BUILD_MODULE in CMakeLists.txt and the aa_module target in BUILD.
+
+module;
+
+#include <aa.hpp>
+
+export module aa;
+
+export namespace aa {
+
+using aa::Argv;
+using aa::Binder;
+using aa::bytes;
+using aa::Diagnostic;
+using aa::duration;
+using aa::Error;
+using aa::ErrorCode;
+using aa::Event;
+using aa::Flag;
+using aa::Option;
+using aa::Overrides;
+using aa::ParseError;
+using aa::Parser;
+using aa::path;
+using aa::PathType;
+using aa::Pattern;
+using aa::rate;
+using aa::SmallVector;
+using aa::Source;
+using aa::StaticFlag;
+using aa::StaticOption;
+using aa::Stats;
+using aa::Values;
+using aa::View;
+
+using aa::operator<<;
+
+using aa::argv;
+using aa::bind;
+using aa::flag;
+using aa::opt;
+using aa::parse;
+using aa::printHelp;
+
+} // namespace aa
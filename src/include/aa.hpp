@@ -1,5 +1,18 @@
 #pragma once
 
+// Everything. Smaller headers, for translation units that need less:
+//
+//   aa/fwd.hpp      forward declarations only
+//   aa/options.hpp  Flag and Option<T>, enough to read parsed values
+//   aa/parser.hpp   Parser and the global flag(), opt() and parse()
+//
+// aa/fwd.hpp and aa/options.hpp are meant to stay light: they include little
+// beyond <atomic>, <memory>, <string> and <vector>, and code that only reads
+// options should need nothing else. aa/parser.hpp costs what parsing takes.
+// With AA_COMPILED, it leaves out aa/parser_impl.hpp and the config file,
+// glob, stat and file watching code behind it. bench/compile_time.cpp fails
+// when any of these go over their budget.
+
 #include <aa/error.hpp>
 #include <aa/options.hpp>
 #include <aa/parser.hpp>
@@ -0,0 +1,93 @@
+#pragma once
+
+#include "convert.hpp"
+#include "internal.hpp"
+#include "options.hpp"
+#include "units.hpp"
+
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace aa {
+
+// Changes to apply to the parsed options when rendering them back into an
+// argv with Parser::argv().
+class Overrides {
+public:
+    template <class T>
+    Overrides& set(const Option<T>& option, const T& value)
+    {
+        auto& entry = at(option.id());
+        entry.remove = false;
+        auto rendered = std::string(internal::formatValue(value, nullptr), ' ');
+        internal::formatValue(value, &rendered[0]);
+        entry.values.assign(1, std::move(rendered));
+        return *this;
+    }
+
+    Overrides& set(const Flag& flag, int count)
+    {
+        auto& entry = at(flag.id());
+        entry.remove = count <= 0;
+        entry.count = count;
+        return *this;
+    }
+
+    template <class O>
+    Overrides& remove(const O& option)
+    {
+        at(option.id()).remove = true;
+        return *this;
+    }
+
+private:
+    friend class Parser;
+
+    struct Entry {
+        size_t index = 0;
+        bool remove = false;
+        int count = 0;
+        std::vector<std::string> values;
+    };
+
+    Entry& at(size_t index)
+    {
+        auto it = std::lower_bound(
+            _entries.begin(), _entries.end(), index,
+            [] (const Entry& entry, size_t i) { return entry.index < i; });
+        if (it == _entries.end() || it->index != index) {
+            it = _entries.insert(it, Entry{});
+            it->index = index;
+        }
+        return *it;
+    }
+
+    // Sorted by option index, to be walked alongside the option list.
+    std::vector<Entry> _entries;
+};
+
+// A null-terminated argv, suitable for execve() or posix_spawn(). The pointer
+// array and the strings share a single allocation.
+class Argv {
+public:
+    int argc() const
+    {
+        return _argc;
+    }
+
+    char** argv() const
+    {
+        return _argv.get();
+    }
+
+private:
+    friend class Parser;
+
+    std::unique_ptr<char*[]> _argv;
+    int _argc = 0;
+};
+
+} // namespace aa
@@ -0,0 +1,293 @@
+#pragma once
+
+#include "convert.hpp"
+#include "error.hpp"
+#include "options.hpp"
+#include "parallel.hpp"
+#include "snapshot.hpp"
+#include "units.hpp"
+
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace aa {
+
+// Option data that lives in a field of the user's struct, bound with
+// Parser::bind(). Values are converted straight into the field, so reading it
+// later is a plain load. A field holds a single value, the last one given;
+// std::vector fields collect them all.
+template <class T>
+struct BoundOptionData final : OptionData {
+    explicit BoundOptionData(T* field)
+        : field(field)
+        , initial(*field)
+    {
+        keepLast = true;
+    }
+
+    bool parseValue(std::string s) override
+    {
+        auto value = T{};
+        if (!internal::Converter<T>::convert(s.data(), s.size(), value)) {
+            return false;
+        }
+        *field = std::move(value);
+        stored = true;
+        return true;
+    }
+
+    void parseValues(
+        const std::vector<View>& raw,
+        unsigned,
+        std::vector<size_t>& rejected) override
+    {
+        for (size_t i = 0; i < raw.size(); i++) {
+            if (!parseValue(raw[i].str())) {
+                rejected.push_back(i);
+            }
+        }
+    }
+
+    bool accepts(const std::string& s) const override
+    {
+        auto value = T{};
+        return internal::Converter<T>::convert(s.data(), s.size(), value);
+    }
+
+    void clearValues() override
+    {
+        *field = initial;
+        stored = false;
+    }
+
+    // Fields cannot be swapped under their readers, so they are not reloaded.
+    void publish(const std::vector<std::string>&) override
+    {
+    }
+
+    void typeTag(std::string& out) const override
+    {
+        internal::Codec<T>::tag(out);
+    }
+
+    void saveValues(std::string& out) const override
+    {
+        auto values = Values<T>{};
+        if (stored) {
+            values.push_back(*field);
+        }
+        internal::Codec<T>::save(out, values);
+    }
+
+    const char* loadValues(const char* p, const char* end) override
+    {
+        auto values = Values<T>{};
+        p = internal::Codec<T>::load(p, end, values);
+        stored = !values.empty();
+        *field = stored ? values.back() : initial;
+        return p;
+    }
+
+    size_t valueCount() const override
+    {
+        return stored ? 1 : 0;
+    }
+
+    size_t formatValue(size_t, char* out) const override
+    {
+        return internal::formatValue(*field, out);
+    }
+
+    std::shared_ptr<void> convertValue(
+        const char* data, size_t size) const override
+    {
+        auto value = std::make_shared<T>();
+        if (!internal::Converter<T>::convert(data, size, *value)) {
+            return nullptr;
+        }
+        return value;
+    }
+
+    // A single value is always the last one, so it is only ever rebuilt.
+    void insertValue(size_t, const void* value) override
+    {
+        *field = *static_cast<const T*>(value);
+        stored = true;
+    }
+
+    void eraseValue(size_t) override
+    {
+        FAIL("BoundOptionData::eraseValue should not be called");
+    }
+
+    std::unique_ptr<OptionData> cloneValues() const override
+    {
+        auto clone = std::unique_ptr<BoundOptionData>{new BoundOptionData};
+        clone->owned = *field;
+        clone->initial = initial;
+        clone->stored = stored;
+        return std::unique_ptr<OptionData>{clone.release()};
+    }
+
+    void assignValues(const OptionData& other) override
+    {
+        const auto& bound = static_cast<const BoundOptionData&>(other);
+        *field = *bound.field;
+        stored = bound.stored;
+    }
+
+    T* field;
+    T initial;
+    bool stored = false;
+
+private:
+    // Copies made by cloneValues() keep their value here.
+    BoundOptionData()
+        : field(&owned)
+        , initial()
+    { }
+
+    T owned{};
+};
+
+template <class T>
+struct BoundOptionData<std::vector<T>> final : OptionData {
+    explicit BoundOptionData(std::vector<T>* field)
+        : field(field)
+        , initial(*field)
+    { }
+
+    bool parseValue(std::string s) override
+    {
+        auto value = T{};
+        if (!internal::Converter<T>::convert(s.data(), s.size(), value)) {
+            return false;
+        }
+        field->push_back(std::move(value));
+        return true;
+    }
+
+    void parseValues(
+        const std::vector<View>& raw,
+        unsigned threads,
+        std::vector<size_t>& rejected) override
+    {
+        auto base = field->size();
+        field->resize(base + raw.size());
+        auto accepted = std::unique_ptr<bool[]>{new bool[raw.size()]};
+        auto chunk = [&] (size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) {
+                accepted[i] = internal::Converter<T>::convert(
+                    raw[i].data, raw[i].size, (*field)[base + i]);
+            }
+        };
+        internal::parallelFor(raw.size(), threads, chunk);
+
+        auto out = base;
+        for (size_t i = 0; i < raw.size(); i++) {
+            if (!accepted[i]) {
+                rejected.push_back(i);
+                continue;
+            }
+            if (out != base + i) {
+                (*field)[out] = std::move((*field)[base + i]);
+            }
+            out++;
+        }
+        field->resize(out);
+    }
+
+    bool accepts(const std::string& s) const override
+    {
+        auto value = T{};
+        return internal::Converter<T>::convert(s.data(), s.size(), value);
+    }
+
+    void clearValues() override
+    {
+        field->clear();
+    }
+
+    void publish(const std::vector<std::string>&) override
+    {
+    }
+
+    void typeTag(std::string& out) const override
+    {
+        internal::Codec<T>::tag(out);
+    }
+
+    void saveValues(std::string& out) const override
+    {
+        auto values = Values<T>{};
+        values.reserve(field->size());
+        for (const auto& value : *field) {
+            values.push_back(value);
+        }
+        internal::Codec<T>::save(out, values);
+    }
+
+    const char* loadValues(const char* p, const char* end) override
+    {
+        auto values = Values<T>{};
+        p = internal::Codec<T>::load(p, end, values);
+        field->assign(values.begin(), values.end());
+        return p;
+    }
+
+    size_t valueCount() const override
+    {
+        return field->size();
+    }
+
+    size_t formatValue(size_t i, char* out) const override
+    {
+        return internal::formatValue((*field)[i], out);
+    }
+
+    std::shared_ptr<void> convertValue(
+        const char* data, size_t size) const override
+    {
+        auto value = std::make_shared<T>();
+        if (!internal::Converter<T>::convert(data, size, *value)) {
+            return nullptr;
+        }
+        return value;
+    }
+
+    void insertValue(size_t at, const void* value) override
+    {
+        field->insert(field->begin() + at, *static_cast<const T*>(value));
+    }
+
+    void eraseValue(size_t at) override
+    {
+        field->erase(field->begin() + at);
+    }
+
+    std::unique_ptr<OptionData> cloneValues() const override
+    {
+        auto clone = std::unique_ptr<BoundOptionData>{new BoundOptionData};
+        clone->owned = *field;
+        return std::unique_ptr<OptionData>{clone.release()};
+    }
+
+    void assignValues(const OptionData& other) override
+    {
+        *field = *static_cast<const BoundOptionData&>(other).field;
+    }
+
+    std::vector<T>* field;
+    std::vector<T> initial;
+
+private:
+    BoundOptionData()
+        : field(&owned)
+    { }
+
+    std::vector<T> owned;
+};
+
+} // namespace aa
@@ -0,0 +1,205 @@
+#pragma once
+
+// Checks of option values, and the Option<T> members that add them. Included
+// by aa/parser.hpp rather than aa/options.hpp, which code reading options
+// includes. Paths are looked up in aa/parser_impl.hpp.
+
+#include "convert.hpp"
+#include "options.hpp"
+#include "units.hpp"
+
+#include <cstddef>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace aa {
+namespace internal {
+
+// The first pass has no branches, so that it vectorizes for arithmetic types;
+// positions are only looked for when something is out of range. Written with
+// negations so that NaN fails.
+template <class T>
+void checkRange(
+    const T* values, size_t n, const T& min, const T& max,
+    std::vector<size_t>& failed)
+{
+    unsigned outside = 0;
+    for (size_t i = 0; i < n; i++) {
+        outside |= static_cast<unsigned>(!(values[i] >= min)) |
+            static_cast<unsigned>(!(values[i] <= max));
+    }
+    if (outside == 0) {
+        return;
+    }
+    for (size_t i = 0; i < n; i++) {
+        if (!(values[i] >= min && values[i] <= max)) {
+            failed.push_back(i);
+        }
+    }
+}
+
+template <class T>
+std::string rangeText(const T& min, const T& max)
+{
+    auto text = std::string{"must be between "};
+    auto at = text.size();
+    text.resize(at + formatValue(min, nullptr));
+    formatValue(min, &text[at]);
+    text += " and ";
+    at = text.size();
+    text.resize(at + formatValue(max, nullptr));
+    formatValue(max, &text[at]);
+    return text;
+}
+
+// Classifies characters without the locale, one table lookup each.
+class CharClasses {
+public:
+    static const CharClasses& get()
+    {
+        static const CharClasses classes;
+        return classes;
+    }
+
+    bool matches(const std::string& s, Pattern pattern) const
+    {
+        if (s.empty()) {
+            return false;
+        }
+        auto bit = static_cast<unsigned char>(1u << static_cast<int>(pattern));
+        for (char c : s) {
+            if (!(_table[static_cast<unsigned char>(c)] & bit)) {
+                return false;
+            }
+        }
+        return pattern != Pattern::Identifier || !(s[0] >= '0' && s[0] <= '9');
+    }
+
+private:
+    CharClasses()
+    {
+        for (int c = 0; c < 256; c++) {
+            bool digit = c >= '0' && c <= '9';
+            bool alpha = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+            bool hex = digit ||
+                (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F');
+            _table[c] = static_cast<unsigned char>(
+                set(Pattern::Digits, digit) |
+                set(Pattern::Hex, hex) |
+                set(Pattern::Alnum, digit || alpha) |
+                set(Pattern::Identifier, digit || alpha || c == '_'));
+        }
+    }
+
+    static unsigned set(Pattern pattern, bool in)
+    {
+        return in ? 1u << static_cast<int>(pattern) : 0u;
+    }
+
+    unsigned char _table[256];
+};
+
+inline const char* patternText(Pattern pattern)
+{
+    switch (pattern) {
+        case Pattern::Digits:
+            return "must be decimal digits";
+        case Pattern::Hex:
+            return "must be hexadecimal";
+        case Pattern::Alnum:
+            return "must be letters and digits";
+        case Pattern::Identifier:
+            return "must be an identifier";
+    }
+    return "must match";
+}
+
+inline const std::string& pathName(const std::string& value)
+{
+    return value;
+}
+
+inline const std::string& pathName(const path& value)
+{
+    return value.name;
+}
+
+inline const char* pathText(PathType type, bool readable)
+{
+    switch (type) {
+        case PathType::Any:
+            break;
+        case PathType::File:
+            return readable ?
+                "must be a readable file" : "must be an existing file";
+        case PathType::Directory:
+            return readable ?
+                "must be a readable directory" :
+                "must be an existing directory";
+    }
+    return readable ? "must be a readable path" : "must be an existing path";
+}
+
+// Looks up all the paths in one batch, then checks what they name. Defined
+// in aa/parser_impl.hpp, with the stat and io_uring code it needs.
+void checkPathNames(
+    const char* const* names, size_t n, PathType type, bool readable,
+    std::vector<size_t>& failed);
+
+template <class T>
+void checkPaths(
+    const T* values, size_t n, PathType type, bool readable,
+    std::vector<size_t>& failed)
+{
+    auto names = std::vector<const char*>(n);
+    for (size_t i = 0; i < n; i++) {
+        names[i] = pathName(values[i]).c_str();
+    }
+    checkPathNames(names.data(), n, type, readable, failed);
+}
+
+} // namespace internal
+
+template <class T>
+Option<T> Option<T>::range(T min, T max)
+{
+    auto expected = internal::rangeText(min, max);
+    return addCheck(
+        [min, max] (const T* values, size_t n, std::vector<size_t>& failed) {
+            internal::checkRange(values, n, min, max, failed);
+        },
+        std::move(expected));
+}
+
+template <class T>
+Option<T> Option<T>::matches(Pattern pattern)
+{
+    return check(
+        [pattern] (const T& value) {
+            return internal::CharClasses::get().matches(value, pattern);
+        },
+        internal::patternText(pattern));
+}
+
+template <class T>
+Option<T> Option<T>::exists(PathType type)
+{
+    return addCheck(
+        [type] (const T* values, size_t n, std::vector<size_t>& failed) {
+            internal::checkPaths(values, n, type, false, failed);
+        },
+        internal::pathText(type, false));
+}
+
+template <class T>
+Option<T> Option<T>::readable(PathType type)
+{
+    return addCheck(
+        [type] (const T* values, size_t n, std::vector<size_t>& failed) {
+            internal::checkPaths(values, n, type, true, failed);
+        },
+        internal::pathText(type, true));
+}
+
+} // namespace aa
@@ -0,0 +1,126 @@
+#pragma once
+
+#include "error.hpp"
+#include "internal.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace aa {
+namespace internal {
+
+// Maps a fixed set of names to values. The table is built with a perfect
+// hash: a seed is searched for so that no two names share a slot, and a
+// lookup then hashes once and compares a single name.
+template <class T>
+class ChoiceTable {
+public:
+    ChoiceTable() = default;
+
+    explicit ChoiceTable(std::vector<std::pair<std::string, T>> choices)
+        : _choices(std::move(choices))
+    {
+        for (size_t capacity = 2; ; capacity *= 2) {
+            if (capacity < 2 * _choices.size()) {
+                continue;
+            }
+            for (std::uint64_t seed = 1; seed <= 256; seed++) {
+                if (build(capacity, seed)) {
+                    return;
+                }
+            }
+            if (capacity > 64 * _choices.size()) {
+                FAIL("duplicate choice names: " + names(", "));
+            }
+        }
+    }
+
+    bool empty() const
+    {
+        return _choices.empty();
+    }
+
+    const T* find(const char* data, size_t size) const
+    {
+        auto slot = _slots[index(hash(data, size), _seed)];
+        if (slot == 0) {
+            return nullptr;
+        }
+        const auto& choice = _choices[slot - 1];
+        if (choice.first.size() != size ||
+                std::memcmp(choice.first.data(), data, size) != 0) {
+            return nullptr;
+        }
+        return &choice.second;
+    }
+
+    const std::vector<std::pair<std::string, T>>& choices() const
+    {
+        return _choices;
+    }
+
+    std::string names(const std::string& separator) const
+    {
+        auto result = std::string{};
+        for (const auto& choice : _choices) {
+            if (!result.empty()) {
+                result += separator;
+            }
+            result += choice.first;
+        }
+        return result;
+    }
+
+private:
+    size_t index(std::uint64_t h, std::uint64_t seed) const
+    {
+        h = (h ^ seed) * 0x9e3779b97f4a7c15ull;
+        return static_cast<size_t>(h >> 32) & (_slots.size() - 1);
+    }
+
+    bool build(size_t capacity, std::uint64_t seed)
+    {
+        _slots.assign(capacity, 0);
+        _seed = seed;
+        for (size_t i = 0; i < _choices.size(); i++) {
+            const auto& name = _choices[i].first;
+            auto& slot = _slots[index(hash(name.data(), name.size()), seed)];
+            if (slot != 0) {
+                return false;
+            }
+            slot = static_cast<std::uint32_t>(i + 1);
+        }
+        return true;
+    }
+
+    std::vector<std::pair<std::string, T>> _choices;
+    // One-based indices into _choices; zero for empty slots.
+    std::vector<std::uint32_t> _slots;
+    std::uint64_t _seed = 0;
+};
+
+// Finds the name of a value, for rendering it back into a command line. Types
+// without == are rendered by formatValue() instead.
+template <class T>
+auto choiceName(const ChoiceTable<T>& table, const T& value, int)
+    -> decltype(void(value == value), static_cast<const std::string*>(nullptr))
+{
+    for (const auto& choice : table.choices()) {
+        if (choice.second == value) {
+            return &choice.first;
+        }
+    }
+    return nullptr;
+}
+
+template <class T>
+const std::string* choiceName(const ChoiceTable<T>&, const T&, long)
+{
+    return nullptr;
+}
+
+}} // namespace aa::internal
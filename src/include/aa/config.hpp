@@ -0,0 +1,154 @@
+#pragma once
+
+#include <cstddef>
+#include <cstring>
+#include <string>
+
+namespace aa {
+namespace internal {
+
+// Whether nothing but blanks and a comment follows a quoted value.
+inline bool endsValue(const char* p, const char* q)
+{
+    while (p < q && (*p == ' ' || *p == '\t')) {
+        ++p;
+    }
+    return p == q || *p == '#' || *p == ';';
+}
+
+inline bool parseConfigValue(const char* p, const char* q, std::string& value)
+{
+    value.clear();
+
+    if (p < q && *p == '\'') {
+        auto close = static_cast<const char*>(
+            std::memchr(p + 1, '\'', static_cast<size_t>(q - p - 1)));
+        if (close == nullptr || !endsValue(close + 1, q)) {
+            return false;
+        }
+        value.assign(p + 1, close);
+        return true;
+    }
+
+    if (p < q && *p == '"') {
+        for (++p; p < q && *p != '"'; ++p) {
+            if (*p != '\\') {
+                value += *p;
+                continue;
+            }
+            if (++p == q) {
+                return false;
+            }
+            switch (*p) {
+                case 'n': value += '\n'; break;
+                case 't': value += '\t'; break;
+                case 'r': value += '\r'; break;
+                case '"': value += '"'; break;
+                case '\\': value += '\\'; break;
+                default: return false;
+            }
+        }
+        return p < q && endsValue(p + 1, q);
+    }
+
+    for (const char* c = p; c < q; ++c) {
+        if (*c == '#' && c > p && (c[-1] == ' ' || c[-1] == '\t')) {
+            q = c;
+            while (q > p && (q[-1] == ' ' || q[-1] == '\t')) {
+                --q;
+            }
+            break;
+        }
+    }
+    value.assign(p, q);
+    return true;
+}
+
+// Parses a subset of INI/TOML in a single pass over a buffer: "key = value"
+// lines, "[section]" headers, comments starting with '#' or ';', and single-
+// or double-quoted values, which may be followed by a comment. Keys inside a section are reported as
+// "section.key".
+//
+// For each entry, calls entry(key, keySize, value), which returns an error
+// message or nullptr. Errors are reported with
+// error(lineNumber, message, lineBegin, lineEnd).
+template <class Entry, class Error>
+void parseConfig(const char* begin, const char* end, Entry entry, Error error)
+{
+    auto isSpace = [] (char c) { return c == ' ' || c == '\t'; };
+
+    const char* section = nullptr;
+    size_t sectionSize = 0;
+    auto name = std::string{};
+    auto value = std::string{};
+
+    size_t lineNumber = 0;
+    for (const char* line = begin; line < end; ) {
+        lineNumber++;
+        auto eol = static_cast<const char*>(
+            std::memchr(line, '\n', static_cast<size_t>(end - line)));
+        if (eol == nullptr) {
+            eol = end;
+        }
+        const char* p = line;
+        const char* q = eol;
+        line = eol + 1;
+
+        while (p < q && isSpace(*p)) {
+            ++p;
+        }
+        while (q > p && (isSpace(q[-1]) || q[-1] == '\r')) {
+            --q;
+        }
+        if (p == q || *p == '#' || *p == ';') {
+            continue;
+        }
+
+        if (*p == '[') {
+            if (q[-1] != ']') {
+                error(lineNumber, "malformed section header", p, q);
+                continue;
+            }
+            section = p + 1;
+            sectionSize = static_cast<size_t>(q - 1 - section);
+            continue;
+        }
+
+        auto equ = static_cast<const char*>(
+            std::memchr(p, '=', static_cast<size_t>(q - p)));
+        if (equ == nullptr) {
+            error(lineNumber, "expected 'key = value'", p, q);
+            continue;
+        }
+
+        const char* keyEnd = equ;
+        while (keyEnd > p && isSpace(keyEnd[-1])) {
+            --keyEnd;
+        }
+        const char* key = p;
+        auto keySize = static_cast<size_t>(keyEnd - p);
+        if (section != nullptr) {
+            name.assign(section, sectionSize);
+            name += '.';
+            name.append(p, keySize);
+            key = name.data();
+            keySize = name.size();
+        }
+
+        const char* v = equ + 1;
+        while (v < q && isSpace(*v)) {
+            ++v;
+        }
+        if (!parseConfigValue(v, q, value)) {
+            error(lineNumber, "malformed value", p, q);
+            continue;
+        }
+
+        const char* message = entry(key, keySize, value);
+        if (message != nullptr) {
+            error(lineNumber, message, p, q);
+        }
+    }
+}
+
+}} // namespace aa::internal
@@ -0,0 +1,276 @@
+#pragma once
+
+#include <cctype>
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <type_traits>
+
+#if __cplusplus >= 201703L || (defined(_MSVC_LANG) && _MSVC_LANG >= 201703L)
+#include <charconv>
+#include <system_error>
+#endif
+
+namespace aa {
+namespace internal {
+
+// Reads the initial values of static options, which are written in the
+// source and so trusted to be well formed.
+template <
+    class T,
+    class = typename std::enable_if<!std::is_enum<T>::value>::type>
+T fromString(const std::string& string)
+{
+    auto stream = std::istringstream{string};
+    auto value = T{};
+    stream >> value;
+    return value;
+}
+
+// Enums without choices are given as their numeric values.
+template <class T>
+typename std::enable_if<std::is_enum<T>::value, T>::type
+fromString(const std::string& string)
+{
+    return static_cast<T>(fromString<long long>(string));
+}
+
+template <>
+inline std::string fromString<std::string>(const std::string& string)
+{
+    return string;
+}
+
+#if !defined(__cpp_lib_to_chars)
+// Reads a number with the widest strto* function for its kind, then checks
+// that it fits. Returns false if it does not.
+template <class T>
+typename std::enable_if<std::is_floating_point<T>::value, bool>::type
+readWidest(const char* string, char** end, T& value)
+{
+    auto number = std::strtold(string, end);
+    if (std::isfinite(number) && (number < std::numeric_limits<T>::lowest() ||
+            number > std::numeric_limits<T>::max())) {
+        return false;
+    }
+    value = static_cast<T>(number);
+    return true;
+}
+
+template <class T>
+typename std::enable_if<
+    std::is_integral<T>::value && std::is_signed<T>::value, bool>::type
+readWidest(const char* string, char** end, T& value)
+{
+    auto number = std::strtoll(string, end, 10);
+    if (number < std::numeric_limits<T>::min() ||
+            number > std::numeric_limits<T>::max()) {
+        return false;
+    }
+    value = static_cast<T>(number);
+    return true;
+}
+
+template <class T>
+typename std::enable_if<std::is_unsigned<T>::value, bool>::type
+readWidest(const char* string, char** end, T& value)
+{
+    auto number = std::strtoull(string, end, 10);
+    if (number > std::numeric_limits<T>::max()) {
+        return false;
+    }
+    value = static_cast<T>(number);
+    return true;
+}
+#endif
+
+// Reads a whole number, with nothing around it but an optional leading +,
+// rejecting values out of the type's range.
+template <class T>
+bool readNumber(const char* data, size_t size, T& value)
+{
+    if (size > 1 && data[0] == '+' && data[1] != '-') {
+        data++;
+        size--;
+    }
+#if defined(__cpp_lib_to_chars)
+    auto result = std::from_chars(data, data + size, value);
+    return result.ec == std::errc{} && result.ptr == data + size;
+#else
+    // The strto* functions also skip whitespace and take signs and, for
+    // unsigned types, wrap negative numbers around.
+    if (size == 0 || data[0] == '+' ||
+            (data[0] == '-' && std::is_unsigned<T>::value) ||
+            std::isspace(static_cast<unsigned char>(data[0]))) {
+        return false;
+    }
+    auto string = std::string(data, size);
+    char* end = nullptr;
+    errno = 0;
+    return readWidest(string.c_str(), &end, value) && errno != ERANGE &&
+        end == string.c_str() + string.size();
+#endif
+}
+
+// Converts option values, from the characters of the argument so that values
+// collected as views need no string of their own. Values that are malformed,
+// or have anything left after them, are rejected by returning false. Types
+// with a syntax of their own specialize it; everything else is read with
+// operator>>.
+template <class T, class = void>
+struct Converter {
+    static bool convert(const char* data, size_t size, T& value)
+    {
+        auto stream = std::istringstream{std::string(data, size)};
+        stream >> value;
+        if (stream.fail()) {
+            return false;
+        }
+        stream.peek();
+        return stream.eof();
+    }
+};
+
+// Numbers are read without a stream. signed char and unsigned char are
+// numbers too, as they are rendered, and char is a single character.
+template <class T>
+struct Converter<T, typename std::enable_if<
+        std::is_arithmetic<T>::value && !std::is_same<T, bool>::value &&
+        !std::is_same<T, char>::value>::type> {
+    static bool convert(const char* data, size_t size, T& value)
+    {
+        return readNumber(data, size, value);
+    }
+};
+
+template <>
+struct Converter<bool> {
+    static bool convert(const char* data, size_t size, bool& value)
+    {
+        if (size == 1 && (data[0] == '0' || data[0] == '1')) {
+            value = data[0] == '1';
+            return true;
+        }
+        if (size == 4 && std::memcmp(data, "true", 4) == 0) {
+            value = true;
+            return true;
+        }
+        if (size == 5 && std::memcmp(data, "false", 5) == 0) {
+            value = false;
+            return true;
+        }
+        return false;
+    }
+};
+
+template <>
+struct Converter<char> {
+    static bool convert(const char* data, size_t size, char& value)
+    {
+        if (size != 1) {
+            return false;
+        }
+        value = data[0];
+        return true;
+    }
+};
+
+// Enums without choices are given as their numeric values.
+template <class T>
+struct Converter<T, typename std::enable_if<std::is_enum<T>::value>::type> {
+    static bool convert(const char* data, size_t size, T& value)
+    {
+        auto number = static_cast<typename std::underlying_type<T>::type>(0);
+        if (!readNumber(data, size, number)) {
+            return false;
+        }
+        value = static_cast<T>(number);
+        return true;
+    }
+};
+
+template <>
+struct Converter<std::string> {
+    static bool convert(const char* data, size_t size, std::string& value)
+    {
+        value.assign(data, size);
+        return true;
+    }
+};
+
+// Formats values for rendering them back into command lines. Each overload
+// writes into out when it is not null, and returns the length either way.
+
+inline size_t formatValue(const std::string& value, char* out)
+{
+    if (out != nullptr) {
+        std::memcpy(out, value.data(), value.size());
+    }
+    return value.size();
+}
+
+inline size_t formatValue(char value, char* out)
+{
+    if (out != nullptr) {
+        *out = value;
+    }
+    return 1;
+}
+
+inline size_t formatValue(bool value, char* out)
+{
+    return formatValue(value ? '1' : '0', out);
+}
+
+template <class T>
+typename std::enable_if<std::is_arithmetic<T>::value, size_t>::type
+formatValue(T value, char* out)
+{
+    char buffer[64];
+#if defined(__cpp_lib_to_chars)
+    auto result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+    auto size = static_cast<size_t>(result.ptr - buffer);
+#else
+    int written = 0;
+    if (std::is_floating_point<T>::value) {
+        written = std::snprintf(buffer, sizeof(buffer), "%.*g",
+            sizeof(T) <= sizeof(float) ? 9 : 17,
+            static_cast<double>(value));
+    } else if (std::is_signed<T>::value) {
+        written = std::snprintf(buffer, sizeof(buffer), "%lld",
+            static_cast<long long>(value));
+    } else {
+        written = std::snprintf(buffer, sizeof(buffer), "%llu",
+            static_cast<unsigned long long>(value));
+    }
+    auto size = static_cast<size_t>(written);
+#endif
+    if (out != nullptr) {
+        std::memcpy(out, buffer, size);
+    }
+    return size;
+}
+
+template <class T>
+typename std::enable_if<std::is_enum<T>::value, size_t>::type
+formatValue(T value, char* out)
+{
+    return formatValue(static_cast<long long>(value), out);
+}
+
+template <class T>
+typename std::enable_if<
+    !std::is_arithmetic<T>::value && !std::is_enum<T>::value, size_t>::type
+formatValue(const T& value, char* out)
+{
+    auto stream = std::ostringstream{};
+    stream << value;
+    return formatValue(stream.str(), out);
+}
+
+}} // namespace aa::internal
@@ -0,0 +1,283 @@
+#pragma once
+
+#include "convert.hpp"
+#include "error.hpp"
+#include "internal.hpp"
+#include "options.hpp"
+
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#if defined(__cpp_lib_format)
+#include <format>
+#include <iterator>
+#endif
+
+namespace aa {
+
+// Identifies each kind of problem found while parsing, and the message
+// template it is rendered with.
+enum class ErrorCode {
+    UnknownOption,
+    UnknownShortOption,
+    UnexpectedValue,
+    MissingValue,
+    InvalidValue,
+    InvalidChoice,
+    NestedTooDeeply,
+    CannotOpen,
+    ConfigFile,
+    Required,
+    Exclusive,
+    AtLeastOne,
+    Implies,
+    TooFew,
+    TooMany,
+    FailedCheck,
+    FailedCheckAt,
+};
+
+// A problem found while parsing. Only what the message needs is recorded;
+// the text is produced by format(), when somebody asks for it.
+struct Diagnostic {
+    ErrorCode code = ErrorCode::UnknownOption;
+    // The option the problem is about.
+    std::shared_ptr<const OptionInfo> option;
+    // Options listed by a restriction.
+    std::vector<std::shared_ptr<const OptionInfo>> options;
+    // The offending argument, value or path, depending on the code.
+    std::string text;
+    // The unknown short option, the offending part of a config file line, or
+    // what a value failed to be.
+    std::string detail;
+    // What was wrong with a config file line.
+    const char* reason = "";
+    // A config file line, an occurrence bound, or the position of an
+    // argument, counting from 1 like argv does.
+    long long number = 0;
+
+    // Appends the message, without a newline.
+    void format(std::string& out) const;
+
+    std::string message() const
+    {
+        auto out = std::string{};
+        format(out);
+        return out;
+    }
+};
+
+namespace internal {
+
+inline const char* messageTemplate(ErrorCode code)
+{
+    switch (code) {
+        case ErrorCode::UnknownOption:
+            return "unknown option: {}";
+        case ErrorCode::UnknownShortOption:
+            return "unknown option: -{} in {}";
+        case ErrorCode::UnexpectedValue:
+            return "option {} does not take a value";
+        case ErrorCode::MissingValue:
+            return "option {} requires a value";
+        case ErrorCode::InvalidValue:
+            return "option {}: invalid value '{}'";
+        case ErrorCode::InvalidChoice:
+            return "option {}: invalid value '{}', expected one of {}";
+        case ErrorCode::NestedTooDeeply:
+            return "arguments read from {} are nested too deeply";
+        case ErrorCode::CannotOpen:
+            return "cannot open {}";
+        case ErrorCode::ConfigFile:
+            return "{}:{}: {}: {}";
+        case ErrorCode::Required:
+            return "option {} is required, but not provided";
+        case ErrorCode::Exclusive:
+            return "options {} are mutually exclusive";
+        case ErrorCode::AtLeastOne:
+            return "one of options {} is required";
+        case ErrorCode::Implies:
+            return "option {} requires {}";
+        case ErrorCode::TooFew:
+            return "option {} must be given at least {} times";
+        case ErrorCode::TooMany:
+            return "option {} must be given at most {} times";
+        case ErrorCode::FailedCheck:
+            return "option {}: value '{}' {}";
+        case ErrorCode::FailedCheckAt:
+            return "option {}: value '{}' in argument {} {}";
+    }
+    return "{}";
+}
+
+#if !defined(__cpp_lib_format)
+// An argument of format(), for standard libraries without std::format.
+struct FormatArg {
+    FormatArg(const std::string& s)
+        : data(s.data())
+        , size(s.size())
+    { }
+
+    FormatArg(const char* s)
+        : data(s)
+        , size(std::strlen(s))
+    { }
+
+    FormatArg(long long n)
+        : number(n)
+    { }
+
+    void append(std::string& out) const
+    {
+        if (data != nullptr) {
+            out.append(data, size);
+            return;
+        }
+        auto at = out.size();
+        out.resize(at + formatValue(number, nullptr));
+        formatValue(number, &out[at]);
+    }
+
+    const char* data = nullptr;
+    size_t size = 0;
+    long long number = 0;
+};
+#endif
+
+// Substitutes the arguments for the {} of a message template, appending to
+// out. Nothing here depends on the locale.
+template <class... Args>
+void format(std::string& out, const char* pattern, const Args&... args)
+{
+#if defined(__cpp_lib_format)
+    std::vformat_to(
+        std::back_inserter(out), pattern, std::make_format_args(args...));
+#else
+    const FormatArg pieces[] = {FormatArg(args)...};
+    size_t next = 0;
+    for (const char* p = pattern; *p != '\0'; p++) {
+        if (p[0] == '{' && p[1] == '}' && next < sizeof...(Args)) {
+            pieces[next++].append(out);
+            p++;
+        } else {
+            out += *p;
+        }
+    }
+#endif
+}
+
+inline std::string optionNames(const OptionInfo& option)
+{
+    return join(option.flags, ",");
+}
+
+inline std::string optionNames(
+    const std::vector<std::shared_ptr<const OptionInfo>>& options)
+{
+    auto result = std::string{};
+    for (const auto& option : options) {
+        if (!result.empty()) {
+            result += ", ";
+        }
+        result += optionNames(*option);
+    }
+    return result;
+}
+
+} // namespace internal
+
+inline void Diagnostic::format(std::string& out) const
+{
+    const char* pattern = internal::messageTemplate(code);
+    auto name = option ? internal::optionNames(*option) : std::string{};
+    auto listed = internal::optionNames(options);
+
+    switch (code) {
+        case ErrorCode::UnknownOption:
+        case ErrorCode::UnexpectedValue:
+        case ErrorCode::NestedTooDeeply:
+        case ErrorCode::CannotOpen:
+            internal::format(out, pattern, text);
+            break;
+        case ErrorCode::UnknownShortOption:
+            internal::format(out, pattern, detail, text);
+            break;
+        case ErrorCode::MissingValue:
+        case ErrorCode::Required:
+            internal::format(out, pattern, name);
+            break;
+        case ErrorCode::InvalidValue:
+            internal::format(out, pattern, name, text);
+            break;
+        case ErrorCode::InvalidChoice:
+            internal::format(
+                out, pattern, name, text,
+                static_cast<const OptionData&>(*option).choices);
+            break;
+        case ErrorCode::ConfigFile:
+            internal::format(out, pattern, text, number, reason, detail);
+            break;
+        case ErrorCode::Exclusive:
+        case ErrorCode::AtLeastOne:
+            internal::format(out, pattern, listed);
+            break;
+        case ErrorCode::Implies:
+            internal::format(out, pattern, name, listed);
+            break;
+        case ErrorCode::TooFew:
+        case ErrorCode::TooMany:
+            internal::format(out, pattern, name, number);
+            break;
+        case ErrorCode::FailedCheck:
+            internal::format(out, pattern, name, text, detail);
+            break;
+        case ErrorCode::FailedCheckAt:
+            internal::format(out, pattern, name, text, number, detail);
+            break;
+    }
+}
+
+// Thrown by Parser::parse() with everything that was wrong. The message lists
+// them one per line, and is only built when what() is first called.
+class ParseError : public Error {
+public:
+    ParseError(
+        std::vector<Diagnostic> diagnostics,
+        const char* file,
+        int line,
+        const char* function)
+        : Error{"parsing failed", file, line, function}
+        , _diagnostics(std::move(diagnostics))
+    { }
+
+    const std::vector<Diagnostic>& diagnostics() const
+    {
+        return _diagnostics;
+    }
+
+    // Appends the messages, each followed by a newline.
+    void format(std::string& out) const
+    {
+        for (const auto& diagnostic : _diagnostics) {
+            diagnostic.format(out);
+            out += '\n';
+        }
+    }
+
+protected:
+    void describe(std::string& out) const override
+    {
+        Error::describe(out);
+        out += ":\n";
+        format(out);
+    }
+
+private:
+    std::vector<Diagnostic> _diagnostics;
+};
+
+} // namespace aa
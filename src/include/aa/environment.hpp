@@ -0,0 +1,27 @@
+#pragma once
+
+#if defined(_WIN32)
+#include <stdlib.h>
+#elif defined(__APPLE__)
+#include <crt_externs.h>
+#else
+extern "C" {
+extern char** environ;
+}
+#endif
+
+namespace aa {
+namespace internal {
+
+inline char** environment()
+{
+#if defined(_WIN32)
+    return _environ;
+#elif defined(__APPLE__)
+    return *_NSGetEnviron();
+#else
+    return environ;
+#endif
+}
+
+}} // namespace aa::internal
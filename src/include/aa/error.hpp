@@ -1,33 +1,75 @@
 #pragma once
 
 #include <exception>
-#include <sstream>
 #include <string>
+#include <utility>
 
 namespace aa {
 
+// The message is put together when what() is first called, so that errors
+// nobody looks at cost no more than a copy of their message.
 class Error : public std::exception {
 public:
     Error() = default;
 
     explicit Error(
-        const std::string& message,
+        std::string message,
+        const char* file,
+        int line,
+        const char* function)
+        : _message(std::move(message))
+        , _file(file)
+        , _function(function)
+        , _line(line)
+    { }
+
+    // For callers whose file and function names are not string literals.
+    // They are copied into the location, since they may not outlive this.
+    explicit Error(
+        std::string message,
         const std::string& file,
         int line,
         const std::string& function)
+        : _message(std::move(message))
+        , _location(file + ':' + std::to_string(line) + " (" + function + "): ")
+    { }
+
+    const char* what() const noexcept override
     {
-        auto stream = std::ostringstream{};
-        stream << file << ":" << line << " (" << function << "): " << message;
-        _message = std::move(stream).str();
+        if (_text.empty()) {
+            try {
+                auto text = std::string{};
+                describe(text);
+                _text = std::move(text);
+            } catch (...) {
+                return _message.c_str();
+            }
+        }
+        return _text.c_str();
     }
 
-    const char* what() const noexcept override
+protected:
+    virtual void describe(std::string& out) const
     {
-        return _message.c_str();
+        out += _location;
+        if (_file != nullptr) {
+            out += _file;
+            out += ':';
+            out += std::to_string(_line);
+            out += " (";
+            out += _function;
+            out += "): ";
+        }
+        out += _message;
     }
 
 private:
     std::string _message;
+    std::string _location;
+    const char* _file = nullptr;
+    const char* _function = nullptr;
+    int _line = 0;
+    mutable std::string _text;
 };
 
 #define FAIL(MESSAGE)                                         \
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+namespace aa {
+
+// Non-owning view of characters.
+struct View {
+    const char* data;
+    size_t size;
+
+    std::string str() const
+    {
+        return data != nullptr ? std::string(data, size) : std::string{};
+    }
+};
+
+// Reported by Parser::listen() for each option occurrence and positional
+// argument. The value views the argument itself, and is only valid for the
+// duration of the callback.
+struct Event {
+    enum Kind { Option, Positional };
+
+    Kind kind;
+
+    // Option id, as returned by Option::id() and Flag::id(). Unused for
+    // positional arguments.
+    size_t option;
+
+    // Raw option value or positional argument. Empty for flags.
+    View value;
+
+    // Index of the argument the option or positional was found in, not
+    // counting the program name.
+    size_t argument;
+};
+
+} // namespace aa
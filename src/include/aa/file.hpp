@@ -0,0 +1,250 @@
+#pragma once
+
+#include "error.hpp"
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <string>
+
+#if defined(_WIN32)
+#include <fcntl.h>
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace aa {
+namespace internal {
+
+// Read-only view of a whole file. The file is memory-mapped where the
+// platform allows it, and read into a buffer otherwise.
+class MappedFile {
+public:
+    explicit MappedFile(const std::string& path)
+    {
+#if defined(_WIN32)
+        auto stream = std::ifstream{path, std::ios::binary};
+        if (!stream) {
+            return;
+        }
+        _buffer.assign(
+            std::istreambuf_iterator<char>{stream},
+            std::istreambuf_iterator<char>{});
+        _data = _buffer.data();
+        _size = _buffer.size();
+        _open = true;
+#else
+        int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            return;
+        }
+
+        struct stat status;
+        if (::fstat(fd, &status) == 0) {
+            _open = true;
+            _size = static_cast<size_t>(status.st_size);
+            if (_size > 0) {
+                void* address =
+                    ::mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+                if (address == MAP_FAILED) {
+                    _open = false;
+                    _size = 0;
+                } else {
+                    _data = static_cast<const char*>(address);
+                    _mapped = true;
+                }
+            }
+        }
+        ::close(fd);
+#endif
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    ~MappedFile()
+    {
+#if !defined(_WIN32)
+        if (_mapped) {
+            ::munmap(const_cast<char*>(_data), _size);
+        }
+#endif
+    }
+
+    bool open() const
+    {
+        return _open;
+    }
+
+    const char* data() const
+    {
+        return _data;
+    }
+
+    size_t size() const
+    {
+        return _size;
+    }
+
+private:
+    const char* _data = nullptr;
+    size_t _size = 0;
+    bool _open = false;
+    bool _mapped = false;
+    std::string _buffer;
+};
+
+// File descriptor opened for reading, where "-" stands for standard input.
+class InputFile {
+public:
+    explicit InputFile(const std::string& path)
+    {
+        if (path == "-") {
+            _fd = 0;
+            _owned = false;
+            return;
+        }
+#if defined(_WIN32)
+        _fd = ::_open(path.c_str(), _O_RDONLY | _O_BINARY);
+#else
+        _fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+#endif
+    }
+
+    InputFile(const InputFile&) = delete;
+    InputFile& operator=(const InputFile&) = delete;
+
+    ~InputFile()
+    {
+        if (_owned && _fd >= 0) {
+#if defined(_WIN32)
+            ::_close(_fd);
+#else
+            ::close(_fd);
+#endif
+        }
+    }
+
+    int fd() const
+    {
+        return _fd;
+    }
+
+private:
+    int _fd = -1;
+    bool _owned = true;
+};
+
+// Splits everything read from a file descriptor into delimited tokens. Data
+// is read in large page-aligned blocks, and tokens are returned as views into
+// the current block; only a token crossing a block boundary is copied.
+class TokenReader {
+public:
+    static const size_t blockSize = size_t{1} << 20;
+
+    TokenReader(int fd, char delimiter)
+        : _fd(fd)
+        , _delimiter(delimiter)
+        , _storage(new char[blockSize + pageSize])
+    {
+        auto address = reinterpret_cast<std::uintptr_t>(_storage.get());
+        _block = _storage.get() + (pageSize - address % pageSize) % pageSize;
+    }
+
+    // Stores the next token in data and size. The token stays valid until
+    // the next call. Returns false at the end of input.
+    bool next(const char*& data, size_t& size)
+    {
+        if (_carried) {
+            _carry.clear();
+            _carried = false;
+        }
+
+        for (;;) {
+            if (_p < _end) {
+                auto delimiter = static_cast<const char*>(std::memchr(
+                    _p, _delimiter, static_cast<size_t>(_end - _p)));
+                if (delimiter != nullptr && _carry.empty()) {
+                    data = _p;
+                    size = static_cast<size_t>(delimiter - _p);
+                    _p = delimiter + 1;
+                    return true;
+                }
+                if (delimiter != nullptr) {
+                    _carry.append(_p, delimiter);
+                    _p = delimiter + 1;
+                    return carried(data, size);
+                }
+                _carry.append(_p, _end);
+                _p = _end;
+                _hasCarry = true;
+            }
+
+            if (_eof) {
+                if (_hasCarry) {
+                    _hasCarry = false;
+                    return carried(data, size);
+                }
+                return false;
+            }
+
+            auto count = readBlock();
+            if (count == 0) {
+                _eof = true;
+            }
+            _p = _block;
+            _end = _block + count;
+        }
+    }
+
+private:
+    static const size_t pageSize = 4096;
+
+    bool carried(const char*& data, size_t& size)
+    {
+        data = _carry.data();
+        size = _carry.size();
+        _carried = true;
+        _hasCarry = false;
+        return true;
+    }
+
+    size_t readBlock()
+    {
+        for (;;) {
+#if defined(_WIN32)
+            auto count = ::_read(
+                _fd, _block, static_cast<unsigned>(blockSize));
+#else
+            auto count = ::read(_fd, _block, blockSize);
+#endif
+            if (count >= 0) {
+                return static_cast<size_t>(count);
+            }
+            if (errno != EINTR) {
+                FAIL("failed to read arguments");
+            }
+        }
+    }
+
+    int _fd;
+    char _delimiter;
+    std::unique_ptr<char[]> _storage;
+    char* _block = nullptr;
+    const char* _p = nullptr;
+    const char* _end = nullptr;
+    std::string _carry;
+    bool _hasCarry = false;
+    bool _carried = false;
+    bool _eof = false;
+};
+
+}} // namespace aa::internal
@@ -0,0 +1,22 @@
+#pragma once
+
+// Forward declarations, for headers that only pass options and parsers
+// around.
+
+namespace aa {
+
+class Argv;
+class Error;
+class Flag;
+class Overrides;
+class ParseError;
+class Parser;
+struct Diagnostic;
+struct Event;
+struct Stats;
+struct View;
+
+template <class T>
+class Option;
+
+} // namespace aa
@@ -0,0 +1,153 @@
+#pragma once
+
+#if defined(__cpp_impl_coroutine)
+
+#include <coroutine>
+#include <exception>
+#include <iterator>
+#include <memory>
+#include <utility>
+
+#define AA_HAS_COROUTINES 1
+
+namespace aa {
+
+// Minimal coroutine generator, an input range over the values it yields.
+// Each value is only valid until the iterator is advanced.
+template <class T>
+class Generator {
+public:
+    struct promise_type {
+        Generator get_return_object()
+        {
+            return Generator{Handle::from_promise(*this)};
+        }
+
+        std::suspend_always initial_suspend() noexcept
+        {
+            return {};
+        }
+
+        std::suspend_always final_suspend() noexcept
+        {
+            return {};
+        }
+
+        std::suspend_always yield_value(const T& yielded) noexcept
+        {
+            value = std::addressof(yielded);
+            return {};
+        }
+
+        void return_void() noexcept
+        {
+        }
+
+        void unhandled_exception()
+        {
+            exception = std::current_exception();
+        }
+
+        const T* value = nullptr;
+        std::exception_ptr exception;
+    };
+
+    using Handle = std::coroutine_handle<promise_type>;
+
+    class iterator {
+    public:
+        using iterator_category = std::input_iterator_tag;
+        using value_type = T;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const T*;
+        using reference = const T&;
+
+        iterator() = default;
+
+        explicit iterator(Handle handle)
+            : _handle(handle)
+        { }
+
+        const T& operator*() const
+        {
+            return *_handle.promise().value;
+        }
+
+        const T* operator->() const
+        {
+            return _handle.promise().value;
+        }
+
+        iterator& operator++()
+        {
+            advance(_handle);
+            return *this;
+        }
+
+        void operator++(int)
+        {
+            ++*this;
+        }
+
+        friend bool operator==(const iterator& it, std::default_sentinel_t)
+        {
+            return !it._handle || it._handle.done();
+        }
+
+    private:
+        Handle _handle;
+    };
+
+    Generator(Generator&& other) noexcept
+        : _handle(std::exchange(other._handle, nullptr))
+    { }
+
+    Generator& operator=(Generator&& other) noexcept
+    {
+        if (this != &other) {
+            if (_handle) {
+                _handle.destroy();
+            }
+            _handle = std::exchange(other._handle, nullptr);
+        }
+        return *this;
+    }
+
+    ~Generator()
+    {
+        if (_handle) {
+            _handle.destroy();
+        }
+    }
+
+    iterator begin()
+    {
+        advance(_handle);
+        return iterator{_handle};
+    }
+
+    std::default_sentinel_t end()
+    {
+        return {};
+    }
+
+private:
+    explicit Generator(Handle handle)
+        : _handle(handle)
+    { }
+
+    static void advance(Handle handle)
+    {
+        handle.resume();
+        if (handle.promise().exception) {
+            std::rethrow_exception(
+                std::exchange(handle.promise().exception, nullptr));
+        }
+    }
+
+    Handle _handle;
+};
+
+} // namespace aa
+
+#endif
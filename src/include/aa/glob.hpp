@@ -0,0 +1,488 @@
+#pragma once
+
+#include "units.hpp"
+
+#include <algorithm>
+#include <bitset>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <mutex>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#if !defined(_WIN32)
+#include <dirent.h>
+#include <sys/stat.h>
+#endif
+
+namespace aa {
+namespace internal {
+
+// Whether a value has unescaped *, ? or [ in it.
+inline bool isGlob(const char* data, size_t size)
+{
+    for (size_t i = 0; i < size; i++) {
+        if (data[i] == '\\') {
+            i++;
+        } else if (data[i] == '*' || data[i] == '?' || data[i] == '[') {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Removes the backslashes escaping characters, as a shell does with values
+// kept as they are. Returns false, leaving out alone, if there are none.
+inline bool unescapeGlob(const char* data, size_t size, std::string& out)
+{
+    if (std::find(data, data + size, '\\') == data + size) {
+        return false;
+    }
+    out.clear();
+    out.reserve(size);
+    for (size_t i = 0; i < size; i++) {
+        if (data[i] == '\\' && i + 1 < size) {
+            i++;
+        }
+        out += data[i];
+    }
+    return true;
+}
+
+// One path component of a glob pattern, compiled into operations matched
+// without recursion: a star only ever needs to remember where it was last
+// tried.
+class GlobSegment {
+public:
+    enum Kind { Literal, Pattern, AnyDepth };
+
+    explicit GlobSegment(const std::string& text)
+    {
+        if (text == "**") {
+            _kind = AnyDepth;
+            return;
+        }
+        for (size_t i = 0; i < text.size(); i++) {
+            char c = text[i];
+            if (c == '\\' && i + 1 < text.size()) {
+                addChar(text[++i]);
+            } else if (c == '*') {
+                _kind = Pattern;
+                if (_ops.empty() || _ops.back().kind != Op::Star) {
+                    _ops.push_back(Op{Op::Star, 0, 0});
+                }
+            } else if (c == '?') {
+                _kind = Pattern;
+                _ops.push_back(Op{Op::Any, 0, 0});
+            } else if (c == '[' && parseClass(text, i)) {
+                _kind = Pattern;
+            } else {
+                addChar(c);
+            }
+        }
+        _matchesDot = !_ops.empty() && _ops.front().kind == Op::Char &&
+            _ops.front().c == '.';
+    }
+
+    Kind kind() const
+    {
+        return _kind;
+    }
+
+    // The component with escapes removed, for literal ones.
+    const std::string& literal() const
+    {
+        return _literal;
+    }
+
+    bool matches(const char* name) const
+    {
+        if (name[0] == '.' && !_matchesDot) {
+            return false;
+        }
+        size_t op = 0;
+        const char* p = name;
+        size_t starOp = _ops.size();
+        const char* starName = nullptr;
+        while (*p != '\0') {
+            if (op < _ops.size() && _ops[op].kind == Op::Star) {
+                starOp = ++op;
+                starName = p;
+            } else if (op < _ops.size() && matchesOne(_ops[op], *p)) {
+                op++;
+                p++;
+            } else if (starName != nullptr) {
+                op = starOp;
+                p = ++starName;
+            } else {
+                return false;
+            }
+        }
+        while (op < _ops.size() && _ops[op].kind == Op::Star) {
+            op++;
+        }
+        return op == _ops.size();
+    }
+
+private:
+    struct Op {
+        enum Kind { Char, Any, Star, Class };
+
+        Kind kind;
+        char c;
+        size_t set;
+    };
+
+    void addChar(char c)
+    {
+        _literal += c;
+        _ops.push_back(Op{Op::Char, c, 0});
+    }
+
+    // Reads [abc], [a-z] or [!abc] starting at text[i], leaving i on the
+    // closing bracket. A [ without one is an ordinary character.
+    bool parseClass(const std::string& text, size_t& i)
+    {
+        size_t j = i + 1;
+        bool negate = j < text.size() && (text[j] == '!' || text[j] == '^');
+        if (negate) {
+            j++;
+        }
+        auto set = std::bitset<256>{};
+        size_t first = j;
+        for (; j < text.size() && (text[j] != ']' || j == first); j++) {
+            auto lo = static_cast<unsigned char>(text[j]);
+            auto hi = lo;
+            if (j + 2 < text.size() && text[j + 1] == '-' &&
+                    text[j + 2] != ']') {
+                hi = static_cast<unsigned char>(text[j + 2]);
+                j += 2;
+            }
+            for (unsigned c = lo; c <= hi; c++) {
+                set.set(c);
+            }
+        }
+        if (j >= text.size()) {
+            return false;
+        }
+        if (negate) {
+            set.flip();
+        }
+        set.reset('/');
+        _sets.push_back(set);
+        _ops.push_back(Op{Op::Class, 0, _sets.size() - 1});
+        i = j;
+        return true;
+    }
+
+    bool matchesOne(const Op& op, char c) const
+    {
+        switch (op.kind) {
+            case Op::Char:
+                return op.c == c;
+            case Op::Any:
+                return true;
+            case Op::Class:
+                return _sets[op.set].test(static_cast<unsigned char>(c));
+            case Op::Star:
+                break;
+        }
+        return false;
+    }
+
+    Kind _kind = Literal;
+    std::string _literal;
+    std::vector<Op> _ops;
+    std::vector<std::bitset<256>> _sets;
+    bool _matchesDot = false;
+};
+
+#if !defined(_WIN32)
+// Expands a glob pattern by walking the directories it can match, on more
+// threads as more directories wait to be read. Literal components are
+// appended without reading their directory, so only the parts of the tree a
+// pattern can reach are visited. Names starting with a dot are only matched
+// by components that start with one, and ** does not descend into them or
+// into symbolic links.
+class GlobWalker {
+public:
+    GlobWalker(const std::string& pattern, unsigned threads)
+        : _threads(threads)
+    {
+        size_t start = 0;
+        if (!pattern.empty() && pattern[0] == '/') {
+            _root = "/";
+            start = 1;
+        }
+        while (start <= pattern.size()) {
+            auto end = pattern.find('/', start);
+            if (end == std::string::npos) {
+                end = pattern.size();
+            }
+            if (end > start) {
+                _segments.emplace_back(pattern.substr(start, end - start));
+            }
+            start = end + 1;
+        }
+        _directoriesOnly = pattern.size() > 1 && pattern.back() == '/';
+    }
+
+    // Appends the paths matched, sorted and without duplicates.
+    void run(std::vector<std::string>& out)
+    {
+        if (_segments.empty()) {
+            return;
+        }
+        _queue.push_back(Item{_root, 0});
+        auto found = std::vector<std::string>{};
+        work(found, false);
+
+        // Nothing is queued or being visited any more, so no thread is added.
+        for (auto& worker : _workers) {
+            worker.join();
+        }
+        if (_error) {
+            std::rethrow_exception(_error);
+        }
+        _found.insert(_found.end(), found.begin(), found.end());
+        std::sort(_found.begin(), _found.end());
+        _found.erase(std::unique(_found.begin(), _found.end()), _found.end());
+        out.insert(out.end(), _found.begin(), _found.end());
+    }
+
+private:
+    struct Item {
+        std::string directory;
+        size_t segment;
+    };
+
+    // Takes items from the queue until it is empty and no thread is
+    // visiting one, since that could add more. Threads counted as idle
+    // when they were started are about to take an item.
+    void work(std::vector<std::string>& found, bool counted)
+    {
+        auto pending = std::vector<Item>{};
+        auto error = std::exception_ptr{};
+        bool visited = false;
+        for (;;) {
+            Item item;
+            {
+                std::unique_lock<std::mutex> lock{_mutex};
+                if (error && !_error) {
+                    _error = error;
+                    _queue.clear();
+                }
+                if (_error) {
+                    pending.clear();
+                }
+                for (auto& next : pending) {
+                    _queue.push_back(std::move(next));
+                }
+                pending.clear();
+                if (visited) {
+                    _busy--;
+                }
+                grow();
+                if (!_queue.empty() || _busy == 0) {
+                    _ready.notify_all();
+                }
+                if (!counted) {
+                    _idle++;
+                }
+                counted = false;
+                _ready.wait(lock, [this] {
+                    return !_queue.empty() || _busy == 0;
+                });
+                _idle--;
+                if (_queue.empty()) {
+                    return;
+                }
+                item = std::move(_queue.back());
+                _queue.pop_back();
+                _busy++;
+            }
+            try {
+                visit(item, pending, found);
+            } catch (...) {
+                error = std::current_exception();
+            }
+            visited = true;
+        }
+    }
+
+    // Starts a thread for each queued item that no idle thread is about to
+    // take, up to the limit. Most patterns never queue more than one
+    // directory at a time, and so run on the calling thread alone.
+    void grow()
+    {
+        // The thread that calls this takes an item too.
+        size_t takers = _idle + 1;
+        while (_queue.size() > takers && _workers.size() + 1 < _threads) {
+            try {
+                _workers.emplace_back([this] {
+                    auto found = std::vector<std::string>{};
+                    work(found, true);
+                    std::lock_guard<std::mutex> lock{_mutex};
+                    _found.insert(_found.end(), found.begin(), found.end());
+                });
+            } catch (const std::system_error&) {
+                _threads = static_cast<unsigned>(_workers.size() + 1);
+                return;
+            }
+            _idle++;
+            takers++;
+        }
+    }
+
+    void visit(
+        const Item& item,
+        std::vector<Item>& pending,
+        std::vector<std::string>& found)
+    {
+        const auto& segment = _segments[item.segment];
+        bool last = item.segment + 1 == _segments.size();
+
+        if (segment.kind() == GlobSegment::Literal) {
+            auto path = join(item.directory, segment.literal().c_str());
+            if (!last) {
+                pending.push_back(Item{std::move(path), item.segment + 1});
+            } else if (exists(path)) {
+                emit(std::move(path), found);
+            }
+            return;
+        }
+
+        bool anyDepth = segment.kind() == GlobSegment::AnyDepth;
+        if (anyDepth && !last) {
+            pending.push_back(Item{item.directory, item.segment + 1});
+        }
+
+        DIR* dir = opendir(item.directory.empty() ?
+            "." : item.directory.c_str());
+        if (dir == nullptr) {
+            return;
+        }
+        while (auto entry = readdir(dir)) {
+            const char* name = entry->d_name;
+            if (name[0] == '.' && (name[1] == '\0' ||
+                    (name[1] == '.' && name[2] == '\0'))) {
+                continue;
+            }
+            if (anyDepth) {
+                if (name[0] == '.') {
+                    continue;
+                }
+                auto path = join(item.directory, name);
+                bool descend = isRealDirectory(entry, path);
+                if (last && (!_directoriesOnly || descend)) {
+                    emit(path, found);
+                }
+                if (descend) {
+                    pending.push_back(Item{std::move(path), item.segment});
+                }
+            } else if (segment.matches(name)) {
+                auto path = join(item.directory, name);
+                if (last) {
+                    if (!_directoriesOnly || isDirectory(entry, path)) {
+                        emit(std::move(path), found);
+                    }
+                } else if (isDirectory(entry, path)) {
+                    pending.push_back(Item{std::move(path), item.segment + 1});
+                }
+            }
+        }
+        closedir(dir);
+    }
+
+    static std::string join(const std::string& directory, const char* name)
+    {
+        if (directory.empty()) {
+            return name;
+        }
+        auto path = directory;
+        if (path.back() != '/') {
+            path += '/';
+        }
+        return path += name;
+    }
+
+    bool exists(const std::string& path) const
+    {
+        struct stat info;
+        if (_directoriesOnly) {
+            return ::stat(path.c_str(), &info) == 0 && S_ISDIR(info.st_mode);
+        }
+        return ::lstat(path.c_str(), &info) == 0;
+    }
+
+    // Follows symbolic links, for components that name a directory.
+    static bool isDirectory(const dirent* entry, const std::string& path)
+    {
+        if (entry->d_type == DT_DIR) {
+            return true;
+        }
+        if (entry->d_type != DT_LNK && entry->d_type != DT_UNKNOWN) {
+            return false;
+        }
+        struct stat info;
+        return ::stat(path.c_str(), &info) == 0 && S_ISDIR(info.st_mode);
+    }
+
+    // Does not follow symbolic links, which could lead ** around in circles.
+    static bool isRealDirectory(const dirent* entry, const std::string& path)
+    {
+        if (entry->d_type != DT_UNKNOWN) {
+            return entry->d_type == DT_DIR;
+        }
+        struct stat info;
+        return ::lstat(path.c_str(), &info) == 0 && S_ISDIR(info.st_mode);
+    }
+
+    void emit(std::string path, std::vector<std::string>& found) const
+    {
+        if (_directoriesOnly) {
+            path += '/';
+        }
+        found.push_back(std::move(path));
+    }
+
+    unsigned _threads;
+    std::string _root;
+    std::vector<GlobSegment> _segments;
+    bool _directoriesOnly = false;
+
+    std::mutex _mutex;
+    std::condition_variable _ready;
+    std::vector<Item> _queue;
+    size_t _busy = 0;
+    size_t _idle = 0;
+    std::vector<std::thread> _workers;
+    std::exception_ptr _error;
+    std::vector<std::string> _found;
+};
+#endif
+
+// Appends the paths a glob pattern matches, sorted. Returns false, appending
+// nothing, if it matches none; like a shell, callers then keep the pattern.
+inline bool expandGlob(
+    const std::string& pattern, unsigned threads,
+    std::vector<std::string>& out)
+{
+#if defined(_WIN32)
+    (void)pattern;
+    (void)threads;
+    (void)out;
+    return false;
+#else
+    auto size = out.size();
+    GlobWalker{pattern, threads}.run(out);
+    return out.size() > size;
+#endif
+}
+
+}} // namespace aa::internal
@@ -1,8 +1,10 @@
 #pragma once
 
-#include <sstream>
+#include <cstddef>
+#include <cstdint>
 #include <string>
 #include <type_traits>
+#include <utility>
 #include <vector>
 
 namespace aa {
@@ -26,30 +28,117 @@ inline bool startsWith(const std::string& string, const std::string& prefix)
 inline std::string join(
     const std::vector<std::string>& strings, const std::string delimiter)
 {
-    auto stream = std::ostringstream{};
+    auto result = std::string{};
 
     auto it = strings.begin();
     if (it != strings.end()) {
-        stream << *it++;
+        result += *it++;
         for (; it != strings.end(); ++it) {
-            stream << delimiter << *it;
+            result += delimiter;
+            result += *it;
         }
     }
 
-    return std::move(stream).str();
+    return result;
 }
 
-template <
-    class T,
-    class = std::enable_if<std::is_default_constructible<T>::value>>
-T fromString(const std::string& string)
+inline std::uint64_t hash(const char* data, size_t size)
 {
-    auto stream = std::istringstream{string};
-    auto value = T{};
-    stream >> value;
-    return value;
+    auto result = std::uint64_t{14695981039346656037ull};
+    for (size_t i = 0; i < size; i++) {
+        result ^= static_cast<unsigned char>(data[i]);
+        result *= 1099511628211ull;
+    }
+    return result;
 }
 
+// Open-addressing hash table keyed by names. Lookups take a pointer and a
+// length, so callers can probe it with slices of larger buffers without
+// building a std::string for every candidate.
+template <class T>
+class NameTable {
+public:
+    bool empty() const
+    {
+        return _size == 0;
+    }
+
+    // Returns false, leaving the table as it was, if the name is already in
+    // it.
+    bool insert(const std::string& name, T value)
+    {
+        if (find(name.data(), name.size()) != nullptr) {
+            return false;
+        }
+        if ((_size + 1) * 2 > _slots.size()) {
+            rehash(_slots.empty() ? 16 : _slots.size() * 2);
+        }
+        place(Slot{hash(name.data(), name.size()), name, std::move(value)});
+        _size++;
+        return true;
+    }
+
+    T* find(const char* data, size_t size)
+    {
+        if (_slots.empty()) {
+            return nullptr;
+        }
+
+        auto h = hash(data, size);
+        auto mask = _slots.size() - 1;
+        for (size_t i = h & mask; ; i = (i + 1) & mask) {
+            auto& slot = _slots[i];
+            if (!slot.used) {
+                return nullptr;
+            }
+            if (slot.hash == h && slot.name.size() == size &&
+                    slot.name.compare(0, size, data, size) == 0) {
+                return &slot.value;
+            }
+        }
+    }
+
+private:
+    struct Slot {
+        Slot() = default;
+
+        Slot(std::uint64_t hash, std::string name, T value)
+            : hash(hash)
+            , name(std::move(name))
+            , value(std::move(value))
+            , used(true)
+        { }
+
+        std::uint64_t hash = 0;
+        std::string name;
+        T value = T{};
+        bool used = false;
+    };
+
+    void rehash(size_t capacity)
+    {
+        auto old = std::move(_slots);
+        _slots = std::vector<Slot>(capacity);
+        for (auto& slot : old) {
+            if (slot.used) {
+                place(std::move(slot));
+            }
+        }
+    }
+
+    void place(Slot slot)
+    {
+        size_t i = slot.hash & (_slots.size() - 1);
+        while (_slots[i].used) {
+            i = (i + 1) & (_slots.size() - 1);
+        }
+        _slots[i] = std::move(slot);
+    }
+
+    std::vector<Slot> _slots;
+    size_t _size = 0;
+};
+
 template<class...>
 struct conjunction : std::true_type {};
 
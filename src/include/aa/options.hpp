@@ -1,61 +1,374 @@
 #pragma once
 
+#include "choices.hpp"
 #include "error.hpp"
+#include "events.hpp"
 #include "internal.hpp"
+#include "small_vector.hpp"
 
-#include <vector>
-#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <iosfwd>
 #include <memory>
-#include <ostream>
 #include <string>
+#include <utility>
+#include <vector>
+
+#if defined(AA_STATS)
+#include <chrono>
+#endif
 
 namespace aa {
 
-struct OptionData {
-    virtual ~OptionData() = default;
-    virtual void parseValue(std::string) = 0;
+class Overrides;
+class Parser;
+
+// Character classes that string values can be restricted to, with
+// Option::matches(). Values must have at least one character.
+enum class Pattern {
+    Digits,
+    Hex,
+    Alnum,
+    // Letters, digits and '_', not starting with a digit.
+    Identifier,
+};
+
+// What paths must name, for Option::exists() and Option::readable().
+enum class PathType {
+    Any,
+    File,
+    Directory,
+};
+
+namespace internal {
+
+// A check run over all values of an option after parsing. It takes the whole
+// array at once, so that it can be a tight loop instead of a call per value.
+// The function is kept behind a plain function pointer, which spares this
+// header <functional>.
+template <class T>
+class Check {
+public:
+    template <class F>
+    Check(F function, std::string expected)
+        : expected(std::move(expected))
+        , _function(std::make_shared<F>(std::move(function)))
+        , _call([] (const void* f, const T* values, size_t n,
+                std::vector<size_t>& failed) {
+            (*static_cast<const F*>(f))(values, n, failed);
+        })
+    { }
+
+    // Appends the positions of the values that fail.
+    void run(const T* values, size_t n, std::vector<size_t>& failed) const
+    {
+        _call(_function.get(), values, n, failed);
+    }
+
+    // Completes "value 'x' ..." in messages.
+    std::string expected;
 
+private:
+    std::shared_ptr<const void> _function;
+    void (*_call)(const void*, const T*, size_t, std::vector<size_t>&);
+};
+
+// A value that failed a check.
+struct Failure {
+    size_t value;
+    const std::string* expected;
+};
+
+} // namespace internal
+
+// Where an option value came from, from lowest to highest precedence. Values
+// from a higher source replace the ones collected from lower sources.
+enum class Source {
+    Default,
+    ConfigFile,
+    Environment,
+    CommandLine,
+};
+
+// What every option has, flags included: its names, where it is among the
+// options of its parser, and how often it was given.
+struct OptionInfo {
     std::vector<std::string> flags;
+    size_t index = 0;
     bool expectsValue = false;
     bool required = false;
     int count = 0;
-    std::string metavar = "VALUE";
+    Source source = Source::Default;
     std::string help;
 };
 
+// The data of an option that takes values.
+struct OptionData : OptionInfo {
+    virtual ~OptionData() = default;
+    // Returns false, storing nothing, for values that do not convert.
+    virtual bool parseValue(std::string) = 0;
+    // Converts values in bulk, on up to the given number of threads, and
+    // appends the accepted ones in order. The positions of rejected ones are
+    // appended to rejected.
+    virtual void parseValues(
+        const std::vector<View>& raw,
+        unsigned threads,
+        std::vector<size_t>& rejected) = 0;
+    virtual bool accepts(const std::string& value) const = 0;
+    virtual void clearValues() = 0;
+    virtual void publish(const std::vector<std::string>& raw) = 0;
+    virtual void typeTag(std::string& out) const = 0;
+    virtual void saveValues(std::string& out) const = 0;
+    virtual const char* loadValues(const char* p, const char* end) = 0;
+    virtual size_t valueCount() const = 0;
+    virtual size_t formatValue(size_t i, char* out) const = 0;
+    // Converts a value on its own, for insertValue() to store later, or
+    // returns null if it does not convert.
+    virtual std::shared_ptr<void> convertValue(
+        const char* data, size_t size) const = 0;
+    // Stores a copy of a value from convertValue() at the given position
+    // among the values.
+    virtual void insertValue(size_t at, const void* value) = 0;
+    virtual void eraseValue(size_t at) = 0;
+    // Copies the values into a new OptionData, for assignValues() to put
+    // them back later.
+    virtual std::unique_ptr<OptionData> cloneValues() const = 0;
+    virtual void assignValues(const OptionData& other) = 0;
+    // Appends the values from begin to end that fail the checks of the
+    // option.
+    virtual void checkValues(
+        size_t, size_t, std::vector<internal::Failure>&) const
+    {
+    }
+
+    // Converts and stores a value, unless a higher source has already
+    // provided one. Returns false if the value was rejected. Defined in
+    // aa/values.hpp.
+    inline bool supply(std::string value, Source from);
+
+    // Keeps only the last value given, overwriting it in place.
+    bool keepLast = false;
+    // Whether values name files, so that glob patterns among them are
+    // expanded when Parser::expandGlobs() is on.
+    bool namesFiles = false;
+    // Whether the option has checks, run over its values after parsing.
+    bool checked = false;
+    // Arguments the values given on the command line came from, kept for
+    // options with checks.
+    std::vector<size_t> arguments;
+    std::string metavar = "VALUE";
+    std::string env;
+    // Names of the accepted values, if they are restricted.
+    std::string choices;
+
+#if defined(AA_STATS)
+    std::uint64_t conversions = 0;
+    std::uint64_t allocations = 0;
+    std::chrono::nanoseconds sampledTime{0};
+#endif
+};
+
+namespace internal {
+
+// A shared_ptr that one thread replaces while others read it.
 template <class T>
-struct TypedOptionData final : OptionData {
-    void parseValue(std::string s) override
+class AtomicShared {
+public:
+    std::shared_ptr<T> load() const
     {
-        values.push_back(internal::fromString<T>(s));
+#if defined(__cpp_lib_atomic_shared_ptr)
+        return _ptr.load(std::memory_order_acquire);
+#else
+        return std::atomic_load_explicit(&_ptr, std::memory_order_acquire);
+#endif
+    }
+
+    void store(std::shared_ptr<T> ptr)
+    {
+#if defined(__cpp_lib_atomic_shared_ptr)
+        _ptr.store(std::move(ptr), std::memory_order_release);
+#else
+        std::atomic_store_explicit(
+            &_ptr, std::move(ptr), std::memory_order_release);
+#endif
     }
 
-    std::vector<T> values;
+private:
+#if defined(__cpp_lib_atomic_shared_ptr)
+    std::atomic<std::shared_ptr<T>> _ptr;
+#else
+    std::shared_ptr<T> _ptr;
+#endif
+};
+
+} // namespace internal
+
+// Member functions are defined in aa/values.hpp, along with value conversion,
+// which code that only reads options does not need.
+template <class T>
+struct TypedOptionData final : OptionData {
+    bool parseValue(std::string s) override;
+    void parseValues(
+        const std::vector<View>& raw,
+        unsigned threads,
+        std::vector<size_t>& rejected) override;
+    bool accepts(const std::string& value) const override;
+    void clearValues() override;
+    void publish(const std::vector<std::string>& raw) override;
+    void typeTag(std::string& out) const override;
+    void saveValues(std::string& out) const override;
+    const char* loadValues(const char* p, const char* end) override;
+    size_t valueCount() const override;
+    size_t formatValue(size_t i, char* out) const override;
+    std::shared_ptr<void> convertValue(
+        const char* data, size_t size) const override;
+    void insertValue(size_t at, const void* value) override;
+    void eraseValue(size_t at) override;
+    std::unique_ptr<OptionData> cloneValues() const override;
+    void assignValues(const OptionData& other) override;
+    void checkValues(
+        size_t begin, size_t end,
+        std::vector<internal::Failure>& failures) const override;
+
+    // Converts a value through its choices, if it has any, or its Converter.
+    bool convert(const std::string& s, T& value) const;
+    bool convert(const char* data, size_t size, T& value) const;
+
+    Values<T> values;
+    internal::ChoiceTable<T> choiceTable;
+    std::vector<internal::Check<T>> checks;
+
+    // Values visible through Option<T>: values until the first publish(),
+    // then the latest snapshot. Readers may hold references into any of them
+    // for as long as they like, so replaced snapshots are kept as long as
+    // this is. publish() skips values that are the same as the last ones, so
+    // only actual changes add a snapshot.
+    std::atomic<const Values<T>*> current{&values};
+    internal::AtomicShared<const Values<T>> published;
+    std::vector<std::shared_ptr<const Values<T>>> retired;
+    std::vector<std::string> publishedRaw;
 };
 
-template <>
-struct TypedOptionData<void> final : OptionData {
-    void parseValue(std::string) override
+namespace internal {
+
+struct FlagBlock;
+
+// What a parser keeps of a flag besides its names and help: where its value
+// is stored, and the bool field it is bound to, if any.
+struct FlagData final : OptionInfo {
+    // Stores the count, and sets the bit of the flag if it is given.
+    inline void set(int count);
+
+    FlagBlock* block = nullptr;
+    std::uint32_t bit = 0;
+    bool* field = nullptr;
+    bool initial = false;
+};
+
+// The values of up to 64 flags of a parser, packed so that reading one is a
+// load of the block's word and a bit test: a bit per flag, set when it was
+// given, and its occurrence count. Flags hold a reference to their block, and
+// so does the parser, through a shared_ptr that the data of the flags alias,
+// so that a flag can be read even after its parser is gone.
+struct FlagBlock {
+    static const size_t capacity = 64;
+
+    static std::shared_ptr<FlagBlock> make()
+    {
+        auto block = new FlagBlock;
+        block->acquire();
+        return std::shared_ptr<FlagBlock>{
+            block, [] (FlagBlock* b) { b->release(); }};
+    }
+
+    void acquire()
     {
-        FAIL("TypedOptionData<void>::parseValue should not be called");
+        references.fetch_add(1, std::memory_order_relaxed);
     }
+
+    void release()
+    {
+        if (references.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            delete this;
+        }
+    }
+
+    std::uint64_t bits = 0;
+    int counts[capacity] = {};
+    // Grows as flags are added, without moving the ones already there.
+    std::deque<FlagData> data;
+    std::atomic<long> references{0};
 };
 
+inline void FlagData::set(int count)
+{
+    auto mask = std::uint64_t{1} << bit;
+    if (count > 0) {
+        block->bits |= mask;
+    } else {
+        block->bits &= ~mask;
+    }
+    block->counts[bit] = count;
+    if (field != nullptr) {
+        *field = count > 0 || initial;
+    }
+}
+
+} // namespace internal
+
+// A flag is a bit in a block of its parser's flags, which it holds a
+// reference to, so it can be read even after the parser is gone. Testing it
+// is a single bit test.
 class Flag final {
 public:
-    explicit Flag(std::shared_ptr<TypedOptionData<void>> data = nullptr)
-        : _data(std::move(data))
-    { }
+    Flag() = default;
+
+    Flag(const Flag& other)
+        : _block(other._block)
+        , _bit(other._bit)
+    {
+        if (_block != nullptr) {
+            _block->acquire();
+        }
+    }
+
+    Flag(Flag&& other) noexcept
+        : _block(other._block)
+        , _bit(other._bit)
+    {
+        other._block = nullptr;
+    }
+
+    Flag& operator=(Flag other) noexcept
+    {
+        std::swap(_block, other._block);
+        std::swap(_bit, other._bit);
+        return *this;
+    }
+
+    ~Flag()
+    {
+        if (_block != nullptr) {
+            _block->release();
+        }
+    }
 
     Flag help(std::string message)
     {
-        _data->help = std::move(message);
+        _block->data[_bit].help = std::move(message);
         return *this;
     }
 
+    size_t id() const
+    {
+        return _block->data[_bit].index;
+    }
+
     int operator*() const
     {
-        return _data->count;
+        return _block->counts[_bit];
     }
 
     operator int() const
@@ -63,8 +376,24 @@ public:
         return **this;
     }
 
+    explicit operator bool() const
+    {
+        return (_block->bits >> _bit) & 1;
+    }
+
 private:
-    std::shared_ptr<TypedOptionData<void>> _data;
+    friend class Overrides;
+    friend class Parser;
+
+    explicit Flag(const internal::FlagData& data)
+        : _block(data.block)
+        , _bit(data.bit)
+    {
+        _block->acquire();
+    }
+
+    internal::FlagBlock* _block = nullptr;
+    std::uint32_t _bit = 0;
 };
 
 template <class T>
@@ -76,6 +405,11 @@ public:
         ASSERT(_data);
     }
 
+    size_t id() const
+    {
+        return _data->index;
+    }
+
     Option metavar(std::string name)
     {
         _data->metavar = std::move(name);
@@ -94,15 +428,103 @@ public:
         return *this;
     }
 
+    Option env(std::string name)
+    {
+        _data->env = std::move(name);
+        return *this;
+    }
+
+    // Restricts values to the given names, which are converted to their
+    // values with a perfect hash instead of fromString().
+    Option choices(std::vector<std::pair<std::string, T>> choices)
+    {
+        _data->choiceTable = internal::ChoiceTable<T>{std::move(choices)};
+        _data->choices = _data->choiceTable.names("|");
+        return *this;
+    }
+
+    // Keeps only the last of repeated values, without growing storage.
+    Option keepLast()
+    {
+        _data->keepLast = true;
+        return *this;
+    }
+
+    // Checks run after parsing, over all values given on the command line,
+    // in the environment or in config files, but not over defaults. Each
+    // runs over the values at once. Failing values are reported with the
+    // argument they were given in. range(), matches(), exists() and
+    // readable() are defined in aa/checks.hpp.
+
+    // Accepts values from min to max, inclusive.
+    Option range(T min, T max);
+
+    Option nonEmpty()
+    {
+        return check(
+            [] (const T& value) { return !value.empty(); },
+            "must not be empty");
+    }
+
+    Option matches(Pattern pattern);
+
+    // Accepts paths that name something, of the given type if not Any. For
+    // std::string and aa::path values. All values are looked up at once, as
+    // asynchronous statx calls on an io_uring where the system has one, on
+    // threads otherwise.
+    Option exists(PathType type = PathType::Any);
+
+    // Same as exists(), also requiring that the permission bits let this
+    // process read them.
+    Option readable(PathType type = PathType::Any);
+
+    // Accepts values for which the predicate returns true. expected completes
+    // the message for others, as in "must be even".
+    template <class F>
+    Option check(F predicate, std::string expected)
+    {
+        return addCheck(
+            [predicate] (
+                const T* values, size_t n, std::vector<size_t>& failed)
+            {
+                for (size_t i = 0; i < n; i++) {
+                    if (!predicate(values[i])) {
+                        failed.push_back(i);
+                    }
+                }
+            },
+            std::move(expected));
+    }
+
     Option init(T&& x)
     {
         _data->values.push_back(std::forward<T>(x));
         return *this;
     }
 
-    const std::vector<T>& all() const
+    // References returned by all() and the accessors below stay valid for
+    // as long as the option, however often its values are reloaded.
+    //
+    // all() used to return a std::vector<T> copy. Values<T> converts to one
+    // implicitly and compares equal to one, so assigning the result to a
+    // std::vector<T>, or passing it where one is taken by value or const
+    // reference, works as before. Code that deduces a std::vector<T> from it,
+    // or uses members a vector has and Values<T> lacks, such as at(), needs
+    // std::vector<T>(option.all()).
+    const Values<T>& all() const
+    {
+        return *_data->current.load(std::memory_order_acquire);
+    }
+
+    // The values, kept alive for as long as the pointer is held, even past
+    // the option.
+    std::shared_ptr<const Values<T>> pinned() const
     {
-        return _data->values;
+        auto published = _data->published.load();
+        if (published) {
+            return published;
+        }
+        return std::shared_ptr<const Values<T>>{_data, &_data->values};
     }
 
     const T& first() const
@@ -139,6 +561,18 @@ public:
     }
 
 private:
+    friend class Overrides;
+    friend class Parser;
+
+    template <class F>
+    Option addCheck(F run, std::string expected)
+    {
+        _data->checks.push_back(
+            internal::Check<T>{std::move(run), std::move(expected)});
+        _data->checked = true;
+        return *this;
+    }
+
     std::shared_ptr<TypedOptionData<T>> _data;
 };
 
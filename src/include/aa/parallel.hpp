@@ -0,0 +1,71 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <exception>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+namespace aa {
+namespace internal {
+
+// Threads to use when none are asked for.
+inline unsigned defaultThreads()
+{
+    auto threads = std::thread::hardware_concurrency();
+    return threads > 0 ? threads : 1;
+}
+
+// Threads to use for work that mostly waits on the file system, where it
+// pays to have many more requests in flight than there are cores.
+inline unsigned ioThreads()
+{
+    return std::max(4 * defaultThreads(), 16u);
+}
+
+// Calls f(begin, end) on contiguous chunks of [0, n), one per thread, and
+// returns when all of them are done. The calling thread takes the first
+// chunk. The first exception thrown by a chunk is rethrown.
+template <class F>
+void parallelFor(size_t n, unsigned threads, F f)
+{
+    if (threads > n) {
+        threads = static_cast<unsigned>(n);
+    }
+    if (threads <= 1) {
+        f(size_t{0}, n);
+        return;
+    }
+
+    auto errors = std::vector<std::exception_ptr>(threads);
+    auto chunk = [&] (unsigned i) {
+        try {
+            f(n * i / threads, n * (i + 1) / threads);
+        } catch (...) {
+            errors[i] = std::current_exception();
+        }
+    };
+
+    auto workers = std::vector<std::thread>{};
+    workers.reserve(threads - 1);
+    for (unsigned i = 1; i < threads; i++) {
+        try {
+            workers.emplace_back(chunk, i);
+        } catch (const std::system_error&) {
+            chunk(i);
+        }
+    }
+    chunk(0);
+    for (auto& worker : workers) {
+        worker.join();
+    }
+
+    for (const auto& error : errors) {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+}
+
+}} // namespace aa::internal
@@ -1,21 +1,60 @@
 #pragma once
 
+#include <aa/argv.hpp>
+#include <aa/bind.hpp>
+#include <aa/checks.hpp>
+#include <aa/choices.hpp>
+#include <aa/convert.hpp>
+#include <aa/diagnostics.hpp>
+#include <aa/environment.hpp>
 #include <aa/error.hpp>
+#include <aa/events.hpp>
+#include <aa/generator.hpp>
 #include <aa/internal.hpp>
 #include <aa/options.hpp>
-
-#include <iostream>
+#include <aa/static.hpp>
+#include <aa/stats.hpp>
+#include <aa/values.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <istream>
+#include <limits>
 #include <map>
+#include <ostream>
 #include <memory>
+#include <mutex>
 #include <set>
-#include <sstream>
 #include <string>
 #include <type_traits>
+#include <unordered_set>
 #include <utility>
 #include <vector>
 
+// With AA_COMPILED defined, Parser's members are compiled once into the
+// aa_compiled library instead of in every translation unit that uses them.
+#if defined(AA_COMPILED)
+#define AA_INLINE
+#else
+#define AA_INLINE inline
+#endif
+
 namespace aa {
 
+template <class S>
+class Binder;
+
+namespace internal {
+
+class FileWatcher;
+
+} // namespace internal
+
 class Parser {
 public:
     template <
@@ -25,7 +64,7 @@ public:
                 std::is_convertible<Names, std::string>...>::value>>
     Flag flag(Names&&... names)
     {
-        return Flag{addData<void>(false, std::forward<Names>(names)...)};
+        return Flag{addFlag({std::forward<Names>(names)...})};
     }
 
     template <
@@ -36,90 +75,204 @@ public:
                 std::is_convertible<Names, std::string>...>::value>>
     Option<T> opt(Names&&... names)
     {
-        return Option<T>{addData<T>(true, std::forward<Names>(names)...)};
+        return Option<T>{addData<T>(true, {std::forward<Names>(names)...})};
     }
 
-    void parse(int argc, char* argv[])
+    // Binds options to the fields of a struct, which parsing then writes to
+    // directly:
+    //
+    //     struct Config { int port = 8080; bool verbose = false; };
+    //     auto config = Config{};
+    //     parser.bind(config)
+    //         .field(&Config::port, "-p", "--port").help("port to listen on")
+    //         .field(&Config::verbose, "-v", "--verbose");
+    //
+    // Fields keep their initial values until an option is given. bool fields
+    // are flags, std::vector fields collect every value, and other fields
+    // hold the last value given. The struct must outlive the parser. Bound
+    // fields are not reloaded by watchConfigFiles().
+    template <class S>
+    Binder<S> bind(S& object)
     {
-        if (argc >= 1) {
-            programName(argv[0]);
-        }
-
-        std::vector<std::string> args;
-        for (int i = 1; i < argc; i++) {
-            args.emplace_back(argv[i]);
-        }
-        parse(args);
+        return Binder<S>{*this, object};
     }
 
-    void parse(const std::vector<std::string>& args)
+    // Both throw a ParseError listing what was wrong, after printing it to
+    // stderr unless printErrors(false) was called.
+    void parse(int argc, char* argv[]);
+
+    void parse(const std::vector<std::string>& args);
+
+    // Whether parse() prints the problems it finds to stderr. Without
+    // printing, messages are only formatted if the ParseError is asked for
+    // them, which saves most of the cost of failing.
+    void printErrors(bool enabled);
+
+    // Returns the counters collected so far. They are only collected when
+    // compiled with AA_STATS defined; otherwise enabled is false, and all the
+    // counters are zero.
+    Stats stats() const;
+
+    // Adds an option that reads more arguments from a file, or from standard
+    // input for "-", like xargs does. Arguments are read where the option
+    // appears, one per line, or separated by NUL characters when the given
+    // flag comes earlier on the command line.
+    void argsFrom(std::string name = "--args-from", std::string nul = "-0");
+
+    // Reports option occurrences and positional arguments to the callback
+    // instead of storing them. Occurrences are still counted, so required
+    // options and restrictions are checked as usual, but option values and
+    // positional arguments are left for the callback to keep.
+    void listen(std::function<void(const Event&)> callback);
+
+#if defined(AA_HAS_COROUTINES)
+    // Parses arguments as they arrive from a stream, separated by the
+    // delimiter ('\0' for the output of find -print0), and yields an event
+    // for each option occurrence and positional argument, like listen().
+    // Memory use is bounded by the longest argument. Each event is valid
+    // until the generator is advanced, and the parser must outlive it.
+    Generator<Event> stream(std::istream& input, char delimiter = '\0');
+
+    // Same as above, reading from a file descriptor in large blocks, which
+    // yields arguments as soon as they are available in a pipe.
+    Generator<Event> stream(int fd, char delimiter = '\0');
+#endif
+
+    // Incremental parsing, for interactive tools that validate a command line
+    // as it is edited. track() parses like parse(), and keeps what each
+    // argument contributed. Each edit then re-reads only the arguments whose
+    // meaning it changes, usually the edited one and the one after it, and
+    // updates only the options they touch. Apart from shifting the positions
+    // of later arguments, its cost does not grow with the length of the
+    // command line; only "--" can change the meaning of everything after it.
+    // Checks run over the values an edit adds, and their results are kept
+    // with the arguments until these go away.
+    // All of them return the problems found, one per line, or an empty
+    // string, instead of throwing. Arguments from files are not expanded, and
+    // listeners are not called.
+    std::string track(const std::vector<std::string>& args);
+
+    std::string insertArg(size_t index, std::string arg);
+
+    std::string replaceArg(size_t index, std::string arg);
+
+    std::string eraseArg(size_t index);
+
+    // Converts the values of options given many times on the command line on
+    // several threads. Off until this is called. Once an option has more than
+    // threshold values, the rest are collected while tokenizing, and
+    // converted in parallel after it, straight into their slots. Values keep
+    // their order, and rejected ones are reported in order, after the other
+    // problems found while tokenizing. With 0 threads, one is used per core.
+    // Options that keep only their last value are always converted as they
+    // come. Starting a thread costs about as much as converting a few hundred
+    // values, so a threshold of a few thousand suits most programs.
+    //
+    // The converters of the options' types run on several threads at once.
+    // Those of aa's own types and of arithmetic types and strings are safe to
+    // run that way; a type read with operator>> must be too.
+    void parallelConversion(size_t threshold, unsigned threads = 0);
+
+    // Expands glob patterns given as values of aa::path options, or as
+    // positional arguments, for programs started without a shell. Patterns
+    // take *, ?, [...] and ** for any number of directories, and \ escapes.
+    // Each is expanded where it is given, by walking the directories it can
+    // match on up to the given number of threads (0 for a default suited to
+    // slow file systems), into matches sorted by name. Threads are only started
+    // as directories wait to be read. Paths matched by several patterns of
+    // an option are only kept once. Patterns that match nothing, and values
+    // without patterns, are kept as they are, with their escapes removed,
+    // like shells do.
+    //
+    // Only on POSIX systems. On Windows, where \ separates directories, this
+    // does nothing.
+    void expandGlobs(bool enabled = true, unsigned threads = 0);
+
+    void printHelp(std::ostream& out) const;
+
+    std::string programName() const;
+
+    void programName(std::string name);
+
+    // Adds a config file to read values from, for options that were not given
+    // on the command line or in the environment. Files are read in the order
+    // they were added, and missing files are skipped.
+    void configFile(std::string path);
+
+    // Serializes the parse results into a compact binary snapshot, which
+    // restore() can load in another process running the same binary with the
+    // same options declared, skipping tokenizing and conversion. restore()
+    // throws aa::Error, leaving the parser as it was, for a snapshot that is
+    // malformed or was made for other options.
+    std::string snapshot() const;
+
+    void restore(const char* data, size_t size);
+
+    void restore(const std::string& snapshot);
+
+    // Renders the parsed options, with overrides applied, back into an argv
+    // for launching a child process. Options are written by their first long
+    // name where they have one, as "--name=value". Defaults are left out.
+    // Everything is sized in a first pass and written in a second one, into a
+    // single allocation.
+    Argv argv(const Overrides& overrides = Overrides{}) const;
+
+    // Re-reads config files in a background thread whenever they change, after
+    // parse(). Options that took their values from config files get the new
+    // values published as an atomic swap, so readers never lock. Values that
+    // were replaced are kept, so that references to them stay valid; each
+    // change to a file that alters an option costs a copy of its values.
+    // Values from the environment or the command line keep precedence,
+    // options whose key was removed keep their last values, and flags are not
+    // reloaded. Problems in the files are printed unless printErrors(false)
+    // was called, and a file with problems is not applied.
+    void watchConfigFiles();
+
+    // Re-reads config files once, the way watchConfigFiles() does when they
+    // change, for programs that reload on a signal instead.
+    void reloadConfigFiles();
+
+    // Restrictions are checked after parsing. Each one is compiled into a
+    // mask over option indices when declared, so checking it takes a few word
+    // operations on the bitset of options seen during parsing.
+
+    template <class... Options>
+    void exclusive(const Options&... options)
     {
-        bool processingFlags = true;
-
-        for (auto arg = args.begin(); arg != args.end(); ) {
-            if (!processingFlags) {
-                _args.push_back(*arg++);
-            } else if (*arg == "--") {
-                processingFlags = false;
-                ++arg;
-            } else if (arg->length() > 2 && internal::startsWith(*arg, "--")) {
-                arg = parseLongOption(arg, args.end());
-            } else if (arg->length() > 1 && internal::startsWith(*arg, "-")) {
-                arg = parseShortOption(arg, args.end());
-            } else {
-                _args.push_back(*arg++);
-            }
-        }
-
-        for (const auto& option : _optionList) {
-            if (option->required && option->count == 0) {
-                _errors << "option " << internal::join(option->flags, ",") <<
-                    " is required, but not provided\n";
-            }
-        }
-
-        auto allErrorText = std::move(_errors).str();
-        if (!allErrorText.empty()) {
-            std::cerr << allErrorText;
-            FAIL("parsing failed");
-        }
+        addRestriction(Restriction::Exclusive, 0, options...);
     }
 
-    void printHelp(std::ostream& out) const
+    template <class... Options>
+    void atLeastOne(const Options&... options)
     {
-        out << "usage: " << _programName;
-        for (const auto& option : _optionList) {
-            bool required = option->required;
-
-            out << " ";
-            if (!required) {
-                out << "[";
-            }
-            out << internal::join(option->flags, "|");
-            if (option->expectsValue) {
-                out << " " << option->metavar;
-            }
-            if (!required) {
-                out << "]";
-            }
-        }
-        out << "\n";
+        addRestriction(Restriction::AtLeastOne, 0, options...);
+    }
 
-        out << "options:\n";
-        for (const auto& option : _optionList) {
-            out << "  " << internal::join(option->flags, ", ") << " " <<
-                option->help << "\n";
-        }
+    template <class O, class... Options>
+    void implies(const O& option, const Options&... dependencies)
+    {
+        addRestriction(
+            Restriction::Implies, option.id(), dependencies...);
     }
 
-    std::string programName() const
+    template <class O>
+    void occurrences(
+        const O& option, int min, int max = std::numeric_limits<int>::max())
     {
-        return _programName;
+        auto restriction = Restriction{};
+        restriction.kind = Restriction::Occurrences;
+        restriction.subject = option.id();
+        restriction.min = min;
+        restriction.max = max;
+        _restrictions.push_back(std::move(restriction));
     }
 
-    void programName(std::string name)
+    // Registers options and flags declared as StaticOption and StaticFlag.
+    template <class... Declarations>
+    void declare(Declarations&... declarations)
     {
-        _programName = std::move(name);
+        int expand[] = {0, (declareOne(declarations), 0)...};
+        (void)expand;
     }
 
     template <class T>
@@ -131,99 +284,519 @@ public:
     }
 
 private:
-    template <class T, class... Names>
+    template <class S>
+    friend class Binder;
+
+    struct Restriction {
+        enum Kind { Exclusive, AtLeastOne, Implies, Occurrences };
+
+        Kind kind = Exclusive;
+        size_t subject = 0;
+        std::vector<std::uint64_t> mask;
+        int min = 0;
+        int max = 0;
+    };
+
+    struct Reloader {
+        Reloader(
+            std::vector<std::string> paths,
+            std::vector<std::shared_ptr<OptionInfo>> options,
+            internal::NameTable<OptionInfo*> table,
+            bool printErrors);
+        ~Reloader();
+
+        void watch();
+
+        // Reads the files again, and publishes the new values only if they
+        // all parse.
+        void reload();
+
+        std::vector<std::string> paths;
+        std::vector<std::shared_ptr<OptionInfo>> options;
+        std::vector<bool> reloadable;
+        internal::NameTable<OptionInfo*> table;
+        bool printErrors;
+        // Reloads from the watcher and from reloadConfigFiles() take turns.
+        std::mutex mutex;
+        // Last, so that its thread stops before the rest goes away.
+        std::unique_ptr<internal::FileWatcher> watcher;
+    };
+
+    // An argument kept by track(), with the tokenizer state it was read in
+    // and what it contributed.
+    struct TrackedArg {
+        struct State {
+            OptionData* pending;
+            bool processingFlags;
+
+            bool operator==(const State& other) const
+            {
+                return pending == other.pending &&
+                    processingFlags == other.processingFlags;
+            }
+        };
+
+        std::string text;
+        // Orders arguments without renumbering them on every insertion.
+        std::uint64_t order = 0;
+        State before{nullptr, true};
+        State after{nullptr, true};
+        std::vector<OptionInfo*> occurrences;
+        // The value is for this option, or is positional if it is null.
+        OptionData* valueOf = nullptr;
+        bool hasValue = false;
+        size_t valueStart = 0;
+        // The value converted for valueOf, kept for every time it is stored.
+        std::shared_ptr<void> converted;
+        std::string error;
+    };
+
+    struct ByOrder {
+        bool operator()(const TrackedArg* lhs, const TrackedArg* rhs) const
+        {
+            return lhs->order < rhs->order;
+        }
+    };
+
+    // What an option had before the tracked command line, with the values
+    // of options that take them.
+    struct Fallback {
+        int count;
+        Source source;
+        std::unique_ptr<OptionData> values;
+    };
+
+    struct Tracker {
+        std::vector<std::unique_ptr<TrackedArg>> args;
+        // Arguments holding the values of each option, and the positional
+        // ones, in order.
+        std::vector<std::vector<const TrackedArg*>> values;
+        std::vector<const TrackedArg*> positionals;
+        // Occurrences of each option among the arguments.
+        std::vector<int> counts;
+        // What each option had from config files, the environment and its
+        // defaults, for when it is no longer on the command line.
+        std::vector<Fallback> fallback;
+        // Options whose values are rebuilt before reporting.
+        std::vector<bool> dirty;
+        std::vector<size_t> dirtyList;
+        std::set<const TrackedArg*, ByOrder> failed;
+        // Arguments whose values fail checks, with what they fail, for each
+        // option; and what its fallback values fail.
+        std::vector<std::map<
+            const TrackedArg*, std::vector<const std::string*>, ByOrder>>
+                checkFailed;
+        std::vector<std::vector<internal::Failure>> fallbackFailed;
+        std::string sourceErrors;
+    };
+
+    template <class T>
     std::shared_ptr<TypedOptionData<T>> addData(
-        bool expectsValue, Names&&... names)
+        bool expectsValue, std::vector<std::string> flags)
     {
         auto data = std::make_shared<TypedOptionData<T>>();
-        data->flags = {std::forward<Names>(names)...};
+        addData(data, expectsValue, std::move(flags));
+        data->namesFiles = internal::NamesFiles<T>::value;
+        return data;
+    }
+
+    void addData(
+        const std::shared_ptr<OptionInfo>& data,
+        bool expectsValue,
+        std::vector<std::string> flags)
+    {
+        data->flags = std::move(flags);
         data->expectsValue = expectsValue;
+        data->index = _optionList.size();
+        _optionList.push_back(data);
 
         for (const auto& flag : data->flags) {
-            _optionList.push_back(data);
+            bool added = false;
             if (flag.length() == 2 && flag.at(0) == '-' && flag.at(1) != '-') {
-                _shortOptions.emplace(flag.at(1), data);
+                added = _shortOptions.emplace(flag.at(1), data).second;
             } else if (flag.length() > 2 && internal::startsWith(flag, "--")) {
-                _longOptions.emplace(flag, data);
+                added = _longOptions.insert(flag, data);
             } else {
                 FAIL("invalid option: " + flag);
             }
+            if (!added) {
+                FAIL("option " + flag + " is already declared");
+            }
         }
+    }
 
+    internal::FlagData& addFlag(std::vector<std::string> flags)
+    {
+        if (!_flagBlock ||
+                _flagBlock->data.size() == internal::FlagBlock::capacity) {
+            _flagBlock = internal::FlagBlock::make();
+        }
+        auto& block = *_flagBlock;
+        block.data.emplace_back();
+        auto& data = block.data.back();
+        data.block = &block;
+        data.bit = static_cast<std::uint32_t>(block.data.size() - 1);
+        // Shares ownership of the block instead of owning a node.
+        addData(
+            std::shared_ptr<OptionInfo>{_flagBlock, &data}, false,
+            std::move(flags));
         return data;
-    };
+    }
 
-    template <class I>
-    I parseLongOption(I arg, I end)
+    template <class T>
+    OptionInfo* bindField(T* field, std::vector<std::string> flags)
     {
-        auto equ = arg->find('=');
-        auto key = arg->substr(0, equ);
-
-        auto optionItr = _longOptions.find(key);
-        if (optionItr == _longOptions.end()) {
-            _errors << "unknown option: " << key << "\n";
-            return std::next(arg);
-        }
-        auto& option = optionItr->second;
+        auto data = std::make_shared<BoundOptionData<T>>(field);
+        addData(data, true, std::move(flags));
+        data->namesFiles = internal::NamesFiles<T>::value;
+        return data.get();
+    }
 
-        // TODO: check for "values" of flags here, right away. And below.
+    OptionInfo* bindField(bool* field, std::vector<std::string> flags)
+    {
+        auto& data = addFlag(std::move(flags));
+        data.field = field;
+        data.initial = *field;
+        return &data;
+    }
 
-        option->count++;
-        if (equ != std::string::npos) {
-            option->parseValue(arg->substr(equ + 1));
+    // Static options and flags belong to one parser at a time.
+    static void checkUndeclared(
+        const OptionInfo* data, const internal::StaticData& info)
+    {
+        if (data != nullptr) {
+            FAIL("option " + internal::join(info.flags(), ",") +
+                " is already declared to a parser");
         }
-        ++arg;
+    }
 
-        if (equ == std::string::npos && arg != end) {
-            option->parseValue(*arg++);
+    template <class T>
+    void declareOne(StaticOption<T>& option)
+    {
+        const auto& info = option._static;
+        checkUndeclared(option._data, info);
+        auto data = addData<T>(true, info.flags());
+        if (info.metavar) {
+            data->metavar = info.metavar;
+        }
+        if (info.help) {
+            data->help = info.help;
+        }
+        if (info.env) {
+            data->env = info.env;
         }
+        data->required = info.required;
+        if (info.init) {
+            data->values.push_back(internal::fromString<T>(info.init));
+        }
+        option._data = data.get();
+        _statics.add(&option._data);
+    }
 
-        return arg;
+    void declareOne(StaticFlag& flag)
+    {
+        checkUndeclared(flag._data, flag._static);
+        auto& data = addFlag(flag._static.flags());
+        if (flag._static.help) {
+            data.help = flag._static.help;
+        }
+        flag._data = &data;
+        _statics.add(&flag._data);
     }
 
-    template <class I>
-    I parseShortOption(I arg, I end)
+    template <class... Options>
+    void addRestriction(
+        Restriction::Kind kind, size_t subject, const Options&... options)
     {
-        for (size_t i = 1; i < arg->length(); i++) {
-            char key = arg->at(i);
-
-            auto optionItr = _shortOptions.find(key);
-            if (optionItr == _shortOptions.end()) {
-                _errors << "unknown option: -" << key << " in " <<
-                    *arg << "\n";
-                return std::next(arg);
-            }
-            auto& option = optionItr->second;
+        auto restriction = Restriction{};
+        restriction.kind = kind;
+        restriction.subject = subject;
+        restriction.mask.resize((_optionList.size() + 63) / 64);
+
+        const size_t indices[] = {options.id()...};
+        for (size_t index : indices) {
+            restriction.mask[index / 64] |= std::uint64_t{1} << (index % 64);
+        }
 
-            option->count++;
-            if (option->expectsValue && i + 1 < arg->length()) {
-                option->parseValue(arg->substr(i + 1));
-                return std::next(arg);
-            }
+        _restrictions.push_back(std::move(restriction));
+    }
 
-            if (option->expectsValue) {
-                ++arg;
-                if (arg != end) {
-                    option->parseValue(*arg++);
-                }
-                return arg;
-            }
-        }
+    // Identifies the declared options and their value types, so that a
+    // snapshot is never loaded into a differently shaped parser.
+    std::uint64_t schemaHash() const;
+
+    static const std::string& argvName(const OptionInfo& option);
 
-        return std::next(arg);
+    // The data of an option that takes values.
+    static OptionData& valuesOf(OptionInfo& option)
+    {
+        return static_cast<OptionData&>(option);
     }
 
-    void checkRestrictions()
+    static const OptionData& valuesOf(const OptionInfo& option)
     {
+        return static_cast<const OptionData&>(option);
     }
 
+    void occurrence(OptionInfo& option, Source from);
+
+    // Records whether the option was given, from its count.
+    void markSeen(OptionInfo& option);
+
+    bool seen(size_t index) const;
+
+    std::vector<std::shared_ptr<const OptionInfo>> listOptions(
+        const std::vector<std::uint64_t>& mask, bool wasSeen) const;
+
+    // Records a problem, to be reported when parsing ends.
+    Diagnostic& diagnose(ErrorCode code, const OptionInfo* option = nullptr);
+
+    // Formats the problems recorded so far, one per line, and forgets them.
+    void takeErrors(std::string& out);
+
+#if defined(AA_HAS_COROUTINES)
+    // Collects events into a vector for the lifetime of a stream() coroutine,
+    // then puts the previous listener back.
+    class ListenerGuard {
+    public:
+        ListenerGuard(Parser& parser, std::vector<Event>& events)
+            : _parser(parser)
+            , _previous(std::move(parser._listener))
+        {
+            _parser._listener = [&events] (const Event& event) {
+                events.push_back(event);
+            };
+        }
+
+        ListenerGuard(const ListenerGuard&) = delete;
+        ListenerGuard& operator=(const ListenerGuard&) = delete;
+
+        ~ListenerGuard()
+        {
+            _parser._listener = std::move(_previous);
+        }
+
+    private:
+        Parser& _parser;
+        std::function<void(const Event&)> _previous;
+    };
+#endif
+
+    void start();
+
+    // Processes a single argument. Options that take a value from the next
+    // argument are kept pending until it arrives.
+    void feed(const char* arg, size_t size);
+
+    void finish();
+
+    void parseLongOption(const char* arg, size_t size, size_t argument);
+
+    void parseShortOption(const char* arg, size_t size, size_t argument);
+
+    void value(
+        OptionData& option, const char* data, size_t size, size_t argument);
+
+    // Stores a value, or reports it to the listener.
+    void storeValue(
+        OptionData& option, const char* data, size_t size, size_t argument);
+
+    void invalidValue(const OptionData& option, const std::string& value);
+
+    // Expands a glob pattern into the matches not yet seen by the option, or
+    // by positional arguments for nullptr, keeping them in _heldArgs. Values
+    // kept as they are get their escapes removed instead. Returns false,
+    // leaving matches empty, if the value is used unchanged.
+    bool expandGlob(
+        const OptionData* option,
+        const char* data,
+        size_t size,
+        std::vector<View>& matches);
+
+    // Converts the values collected for parallel conversion.
+    void convertBulkValues();
+
+    void readArgs(const std::string& path);
+
+    void flagEvent(const OptionInfo& option, size_t argument);
+
+    void positional(const char* data, size_t size, size_t argument);
+
+    void storePositional(const char* data, size_t size, size_t argument);
+
+    void loadConfigFiles();
+
+    // Maps config file keys onto options by their long names.
+    internal::NameTable<OptionInfo*> configTable() const;
+
+    // Flags in config files are either booleans or occurrence counts.
+    static int flagCount(const std::string& value);
+
+    // Fills options that were not given on the command line from their
+    // environment variables. The environment is scanned once, and each entry
+    // is matched against a table of the declared variable names.
+    void resolveEnvironment();
+
+    // Runs the checks of options over their values, reporting failures in
+    // the order of the values.
+    void runChecks();
+
+    // Reports a value that failed a check, with the argument it was given
+    // in if that is known.
+    Diagnostic& failedCheck(
+        const OptionData& option, size_t value, const std::string& expected,
+        bool located);
+
+    void checkRestrictions();
+
+    // Picks an order for an argument inserted at index, renumbering all of
+    // them when there is no room left between its neighbours.
+    std::uint64_t trackedOrder(size_t index);
+
+    // Reads an argument in the state it starts in, like feed() does, and
+    // records what it contributes instead of applying it.
+    void classify(TrackedArg& arg);
+
+    // Applies what an argument contributes, or takes it back for -1.
+    void contribute(const TrackedArg& arg, int sign);
+
+    // Re-reads arguments from index on, for as long as the state they start
+    // in differs from the one they were read in.
+    void retrack(size_t index, TrackedArg::State before);
+
+    void markDirty(size_t index);
+
+    // Rebuilds the values and count of an option from its arguments.
+    void refresh(OptionInfo& option);
+
+    // Runs the checks of an option over its values from begin to end, and
+    // records the arguments holding the ones that fail.
+    void checkTracked(const OptionData& option, size_t begin, size_t end);
+
+    // The position of the argument an option value was given in.
+    size_t trackedArgument(
+        const TrackedArg& arg, const OptionData& option) const;
+
+    // Reports the failed checks recorded for the tracked command line, or
+    // those of the fallback values of options not on it.
+    void trackedChecks();
+
+    std::string trackedErrors();
+
     std::string _programName = "PROGRAM";
     std::vector<std::string> _args;
-    std::map<char, std::shared_ptr<OptionData>> _shortOptions;
-    std::map<std::string, std::shared_ptr<OptionData>> _longOptions;
-    std::vector<std::shared_ptr<OptionData>> _optionList;
-    std::ostringstream _errors;
+    std::map<char, std::shared_ptr<OptionInfo>> _shortOptions;
+    internal::NameTable<std::shared_ptr<OptionInfo>> _longOptions;
+    std::vector<std::shared_ptr<OptionInfo>> _optionList;
+    std::vector<Restriction> _restrictions;
+    std::vector<std::string> _configFiles;
+    std::vector<std::uint64_t> _seen;
+    // The block new flags are added to, until it is full.
+    std::shared_ptr<internal::FlagBlock> _flagBlock;
+    internal::StaticLinks _statics;
+    std::vector<Diagnostic> _diagnostics;
+    bool _printErrors = true;
+    // Reused for printing errors.
+    std::string _errorText;
     std::set<std::string> _breakers;
+    std::function<void(const Event&)> _listener;
+    OptionData* _pending = nullptr;
+    size_t _pendingArgument = 0;
+    size_t _argument = 0;
+    bool _processingFlags = true;
+    OptionData* _argsFrom = nullptr;
+    OptionInfo* _argsFromNul = nullptr;
+    int _argsFromDepth = 0;
+    // Off by default, since converters then run on several threads.
+    size_t _parallelThreshold = std::numeric_limits<size_t>::max();
+    unsigned _parallelThreads = 0;
+    // Values collected for parallel conversion, per option.
+    std::vector<std::vector<View>> _bulkValues;
+    // Copies of collected values read from files, which the views point to.
+    std::deque<std::string> _heldArgs;
+    bool _expandGlobs = false;
+    unsigned _globThreads = 0;
+    // Glob matches kept so far, per option, then for positional arguments.
+    std::vector<std::unordered_set<std::string>> _globbed;
+#if defined(AA_STATS)
+    Stats _stats;
+    std::chrono::steady_clock::time_point _parseStart;
+#endif
+    std::unique_ptr<Reloader> _reloader;
+    std::unique_ptr<Tracker> _tracker;
+};
+
+// Binds the options of one struct, from Parser::bind(). help(), required(),
+// env() and metavar() apply to the field bound last.
+template <class S>
+class Binder {
+public:
+    template <
+        class T,
+        class... Names,
+        class = std::enable_if<
+            internal::conjunction<
+                std::is_convertible<Names, std::string>...>::value>>
+    Binder& field(T S::* member, Names&&... names)
+    {
+        _last = _parser.bindField(
+            &(_object.*member), {std::forward<Names>(names)...});
+        return *this;
+    }
+
+    Binder& metavar(std::string name)
+    {
+        lastWithValues().metavar = std::move(name);
+        return *this;
+    }
+
+    Binder& required()
+    {
+        last().required = true;
+        return *this;
+    }
+
+    Binder& help(std::string message)
+    {
+        last().help = std::move(message);
+        return *this;
+    }
+
+    Binder& env(std::string name)
+    {
+        lastWithValues().env = std::move(name);
+        return *this;
+    }
+
+private:
+    friend class Parser;
+
+    Binder(Parser& parser, S& object)
+        : _parser(parser)
+        , _object(object)
+    { }
+
+    OptionInfo& last()
+    {
+        if (_last == nullptr) {
+            FAIL("no field is bound yet");
+        }
+        return *_last;
+    }
+
+    OptionData& lastWithValues()
+    {
+        auto& option = last();
+        if (!option.expectsValue) {
+            FAIL("option " + internal::join(option.flags, ",") +
+                " is a flag, which takes no value");
+        }
+        return static_cast<OptionData&>(option);
+    }
+
+    Parser& _parser;
+    S& _object;
+    OptionInfo* _last = nullptr;
 };
 
 namespace internal {
@@ -241,11 +814,30 @@ inline void parse(int argc, char* argv[])
     internal::parser().parse(argc, argv);
 }
 
+// Declares static options and flags to the global parser, then parses.
+template <class... Declarations>
+void parse(int argc, char* argv[], Declarations&... declarations)
+{
+    internal::parser().declare(declarations...);
+    internal::parser().parse(argc, argv);
+}
+
+template <class S>
+Binder<S> bind(S& object)
+{
+    return internal::parser().bind(object);
+}
+
 inline void printHelp(std::ostream& out)
 {
     internal::parser().printHelp(out);
 }
 
+inline Argv argv(const Overrides& overrides = Overrides{})
+{
+    return internal::parser().argv(overrides);
+}
+
 template <
     class... Names,
     class = std::enable_if<
@@ -268,3 +860,7 @@ Option<T> opt(Names&&... names)
 }
 
 } // namespace aa
+
+#if !defined(AA_COMPILED)
+#include <aa/parser_impl.hpp>
+#endif
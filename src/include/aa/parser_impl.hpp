@@ -0,0 +1,1626 @@
+#pragma once
+
+// Out-of-line members of Parser, and the functions behind path checks.
+// Included by parser.hpp, or compiled once into the aa_compiled library when
+// AA_COMPILED is defined.
+
+#include "parser.hpp"
+
+// Only needed by the members defined here, so that translation units built
+// against aa_compiled do not parse them.
+#include "config.hpp"
+#include "file.hpp"
+#include "glob.hpp"
+#include "stat.hpp"
+#include "watcher.hpp"
+
+namespace aa {
+namespace internal {
+
+AA_INLINE void checkPathNames(
+    const char* const* names, size_t n, PathType type, bool readable,
+    std::vector<size_t>& failed)
+{
+    auto statuses = std::vector<FileStatus>(n);
+    statPaths(names, n, statuses.data());
+
+    auto reader = readable ? std::unique_ptr<Reader>{new Reader} : nullptr;
+    for (size_t i = 0; i < n; i++) {
+        const auto& status = statuses[i];
+        auto kind = status.mode & S_IFMT;
+        if (!status.found ||
+                (type == PathType::File && kind != S_IFREG) ||
+                (type == PathType::Directory && kind != S_IFDIR) ||
+                (reader && !reader->canRead(status))) {
+            failed.push_back(i);
+        }
+    }
+}
+
+} // namespace internal
+
+AA_INLINE void Parser::parse(int argc, char* argv[])
+{
+    if (argc >= 1) {
+        programName(argv[0]);
+    }
+
+    start();
+    for (int i = 1; i < argc; i++) {
+        feed(argv[i], std::strlen(argv[i]));
+    }
+    finish();
+}
+
+AA_INLINE void Parser::parse(const std::vector<std::string>& args)
+{
+    start();
+    for (const auto& arg : args) {
+        feed(arg.data(), arg.size());
+    }
+    finish();
+}
+
+AA_INLINE void Parser::printErrors(bool enabled)
+{
+    _printErrors = enabled;
+}
+
+AA_INLINE Stats Parser::stats() const
+{
+    auto result = Stats{};
+#if defined(AA_STATS)
+    result = _stats;
+    result.enabled = true;
+    for (const auto& info : _optionList) {
+        if (!info->expectsValue) {
+            continue;
+        }
+        auto option = &valuesOf(*info);
+        result.allocations += option->allocations;
+        if (option->conversions == 0) {
+            continue;
+        }
+
+        auto type = std::string{};
+        option->typeTag(type);
+        auto conversions = std::find_if(
+            result.conversions.begin(), result.conversions.end(),
+            [&type] (const Stats::Conversions& c) {
+                return c.type == type;
+            });
+        if (conversions == result.conversions.end()) {
+            result.conversions.emplace_back();
+            conversions = std::prev(result.conversions.end());
+            conversions->type = type;
+        }
+
+        auto sampled = (option->conversions +
+            Stats::conversionSampleRate - 1) /
+            Stats::conversionSampleRate;
+        conversions->count += option->conversions;
+        conversions->time += option->sampledTime *
+            static_cast<std::int64_t>(option->conversions) /
+            static_cast<std::int64_t>(sampled);
+    }
+#endif
+    return result;
+}
+
+AA_INLINE void Parser::argsFrom(std::string name, std::string nul)
+{
+    _argsFrom = opt<std::string>(std::move(name))
+        .metavar("FILE")
+        .help("read more arguments from FILE, or - for standard input")
+        ._data.get();
+    flag(std::move(nul))
+        .help("arguments read from files are separated by NUL");
+    _argsFromNul = _optionList.back().get();
+}
+
+AA_INLINE void Parser::listen(std::function<void(const Event&)> callback)
+{
+    _listener = std::move(callback);
+}
+
+#if defined(AA_HAS_COROUTINES)
+AA_INLINE Generator<Event> Parser::stream(std::istream& input, char delimiter)
+{
+    auto events = std::vector<Event>{};
+    auto guard = ListenerGuard{*this, events};
+
+    start();
+    auto token = std::string{};
+    while (std::getline(input, token, delimiter)) {
+        feed(token.data(), token.size());
+        for (const auto& event : events) {
+            co_yield event;
+        }
+        events.clear();
+    }
+    finish();
+}
+#endif
+
+#if defined(AA_HAS_COROUTINES)
+AA_INLINE Generator<Event> Parser::stream(int fd, char delimiter)
+{
+    auto events = std::vector<Event>{};
+    auto guard = ListenerGuard{*this, events};
+
+    start();
+    auto reader = internal::TokenReader{fd, delimiter};
+    const char* token = nullptr;
+    size_t size = 0;
+    while (reader.next(token, size)) {
+        feed(token, size);
+        for (const auto& event : events) {
+            co_yield event;
+        }
+        events.clear();
+    }
+    finish();
+}
+#endif
+
+AA_INLINE std::string Parser::track(const std::vector<std::string>& args)
+{
+    start();
+    loadConfigFiles();
+    resolveEnvironment();
+
+    _tracker.reset(new Tracker);
+    auto& tracker = *_tracker;
+    takeErrors(tracker.sourceErrors);
+
+    auto size = _optionList.size();
+    tracker.values.resize(size);
+    tracker.counts.assign(size, 0);
+    tracker.dirty.assign(size, false);
+    tracker.checkFailed.resize(size);
+    tracker.fallbackFailed.resize(size);
+    for (const auto& info : _optionList) {
+        tracker.fallback.push_back(
+            Fallback{info->count, info->source, nullptr});
+        if (!info->expectsValue) {
+            continue;
+        }
+        const auto& option = valuesOf(*info);
+        tracker.fallback.back().values = option.cloneValues();
+        if (option.checked && option.source != Source::Default) {
+            option.checkValues(
+                0, option.valueCount(),
+                tracker.fallbackFailed[option.index]);
+        }
+    }
+
+    auto before = TrackedArg::State{nullptr, true};
+    for (const auto& text : args) {
+        auto arg = std::unique_ptr<TrackedArg>{new TrackedArg};
+        arg->text = text;
+        arg->order = trackedOrder(tracker.args.size());
+        arg->before = before;
+        classify(*arg);
+        contribute(*arg, 1);
+        before = arg->after;
+        tracker.args.push_back(std::move(arg));
+    }
+    return trackedErrors();
+}
+
+AA_INLINE std::string Parser::insertArg(size_t index, std::string text)
+{
+    if (!_tracker || index > _tracker->args.size()) {
+        FAIL("no argument to insert before at " + std::to_string(index));
+    }
+    auto& args = _tracker->args;
+
+    auto arg = std::unique_ptr<TrackedArg>{new TrackedArg};
+    arg->text = std::move(text);
+    arg->order = trackedOrder(index);
+    if (index > 0) {
+        arg->before = args[index - 1]->after;
+    }
+    classify(*arg);
+    contribute(*arg, 1);
+    auto after = arg->after;
+    args.insert(args.begin() + index, std::move(arg));
+
+    retrack(index + 1, after);
+    return trackedErrors();
+}
+
+AA_INLINE std::string Parser::replaceArg(size_t index, std::string text)
+{
+    if (!_tracker || index >= _tracker->args.size()) {
+        FAIL("no argument to replace at " + std::to_string(index));
+    }
+    auto& arg = *_tracker->args[index];
+
+    contribute(arg, -1);
+    arg.text = std::move(text);
+    classify(arg);
+    contribute(arg, 1);
+
+    retrack(index + 1, arg.after);
+    return trackedErrors();
+}
+
+AA_INLINE std::string Parser::eraseArg(size_t index)
+{
+    if (!_tracker || index >= _tracker->args.size()) {
+        FAIL("no argument to erase at " + std::to_string(index));
+    }
+    auto& args = _tracker->args;
+
+    contribute(*args[index], -1);
+    auto before = args[index]->before;
+    args.erase(args.begin() + index);
+
+    retrack(index, before);
+    return trackedErrors();
+}
+
+AA_INLINE void Parser::parallelConversion(size_t threshold, unsigned threads)
+{
+    _parallelThreshold = threshold;
+    _parallelThreads = threads;
+}
+
+AA_INLINE void Parser::expandGlobs(bool enabled, unsigned threads)
+{
+#if defined(_WIN32)
+    (void)enabled;
+#else
+    _expandGlobs = enabled;
+#endif
+    _globThreads = threads;
+}
+
+AA_INLINE void Parser::printHelp(std::ostream& out) const
+{
+    out << "usage: " << _programName;
+    for (const auto& option : _optionList) {
+        bool required = option->required;
+
+        out << " ";
+        if (!required) {
+            out << "[";
+        }
+        out << internal::join(option->flags, "|");
+        if (option->expectsValue) {
+            out << " " << valuesOf(*option).metavar;
+        }
+        if (!required) {
+            out << "]";
+        }
+    }
+    out << "\n";
+
+    out << "options:\n";
+    for (const auto& option : _optionList) {
+        out << "  " << internal::join(option->flags, ", ") << " " <<
+            option->help;
+        if (option->expectsValue) {
+            const auto& data = valuesOf(*option);
+            if (!data.choices.empty()) {
+                out << " [choices: " << data.choices << "]";
+            }
+            if (!data.env.empty()) {
+                out << " [env: " << data.env << "]";
+            }
+        }
+        out << "\n";
+    }
+}
+
+AA_INLINE std::string Parser::programName() const
+{
+    return _programName;
+}
+
+AA_INLINE void Parser::programName(std::string name)
+{
+    _programName = std::move(name);
+}
+
+AA_INLINE void Parser::configFile(std::string path)
+{
+    _configFiles.push_back(std::move(path));
+}
+
+AA_INLINE std::string Parser::snapshot() const
+{
+    auto out = std::string{
+        internal::snapshotMagic, internal::snapshotMagicSize};
+    internal::put<std::uint64_t>(out, schemaHash());
+    internal::putString(out, _programName);
+
+    internal::put<std::uint64_t>(out, _args.size());
+    for (const auto& arg : _args) {
+        internal::putString(out, arg);
+    }
+
+    for (const auto& option : _optionList) {
+        internal::put<std::int32_t>(out, option->count);
+        internal::put<std::uint8_t>(
+            out, static_cast<std::uint8_t>(option->source));
+        if (option->expectsValue) {
+            valuesOf(*option).saveValues(out);
+        }
+    }
+    return out;
+}
+
+AA_INLINE void Parser::restore(const char* data, size_t size)
+{
+    const char* p = data;
+    const char* end = data + size;
+
+    if (size < internal::snapshotMagicSize || std::memcmp(
+            p, internal::snapshotMagic, internal::snapshotMagicSize) != 0) {
+        FAIL("not an option snapshot");
+    }
+    p += internal::snapshotMagicSize;
+
+    auto hash = std::uint64_t{};
+    p = internal::get(p, end, hash);
+    if (hash != schemaHash()) {
+        FAIL("option snapshot was made for different options");
+    }
+
+    // Everything is decoded before any of it is stored, so that a snapshot
+    // that turns out to be malformed leaves the parser as it was.
+    auto programName = std::string{};
+    p = internal::getString(p, end, programName);
+
+    auto argCount = std::uint64_t{};
+    p = internal::get(p, end, argCount);
+    auto args = std::vector<std::string>{};
+    for (std::uint64_t i = 0; i < argCount; i++) {
+        args.emplace_back();
+        p = internal::getString(p, end, args.back());
+    }
+
+    struct Loaded {
+        std::int32_t count;
+        Source source;
+        std::unique_ptr<OptionData> values;
+    };
+    auto loaded = std::vector<Loaded>{};
+    loaded.reserve(_optionList.size());
+    for (const auto& option : _optionList) {
+        auto count = std::int32_t{};
+        auto source = std::uint8_t{};
+        p = internal::get(p, end, count);
+        p = internal::get(p, end, source);
+        if (count < 0 ||
+                source > static_cast<std::uint8_t>(Source::CommandLine)) {
+            FAIL("corrupt option snapshot");
+        }
+        auto values = std::unique_ptr<OptionData>{};
+        if (option->expectsValue) {
+            values = valuesOf(*option).cloneValues();
+            p = values->loadValues(p, end);
+        }
+        loaded.push_back(
+            Loaded{count, static_cast<Source>(source), std::move(values)});
+    }
+    if (p != end) {
+        FAIL("option snapshot has trailing bytes");
+    }
+
+    _programName = std::move(programName);
+    _args = std::move(args);
+    _seen.assign((_optionList.size() + 63) / 64, 0);
+    for (size_t i = 0; i < _optionList.size(); i++) {
+        auto& option = *_optionList[i];
+        if (option.expectsValue) {
+            valuesOf(option).assignValues(*loaded[i].values);
+        }
+        option.count = loaded[i].count;
+        option.source = loaded[i].source;
+        markSeen(option);
+    }
+}
+
+AA_INLINE void Parser::restore(const std::string& snapshot)
+{
+    restore(snapshot.data(), snapshot.size());
+}
+
+AA_INLINE Argv Parser::argv(const Overrides& overrides) const
+{
+    auto result = Argv{};
+    char** pointers = nullptr;
+    char* chars = nullptr;
+    size_t argc = 0;
+    size_t size = 0;
+
+    auto token = [&] (const char* data, size_t n) {
+        if (pointers != nullptr) {
+            pointers[argc] = chars + size;
+            std::memcpy(chars + size, data, n);
+        }
+        argc++;
+        size += n;
+    };
+    auto append = [&] (const char* data, size_t n) {
+        if (chars != nullptr) {
+            std::memcpy(chars + size, data, n);
+        }
+        size += n;
+    };
+    auto finish = [&] {
+        if (chars != nullptr) {
+            chars[size] = '\0';
+        }
+        size++;
+    };
+
+    for (int pass = 0; pass < 2; pass++) {
+        argc = 0;
+        size = 0;
+
+        token(_programName.data(), _programName.size());
+        finish();
+
+        auto entry = overrides._entries.begin();
+        for (const auto& option : _optionList) {
+            const Overrides::Entry* override = nullptr;
+            if (entry != overrides._entries.end() &&
+                    entry->index == option->index) {
+                override = &*entry++;
+            }
+            if (override != nullptr && override->remove) {
+                continue;
+            }
+
+            const auto& name = argvName(*option);
+            bool isLong = internal::startsWith(name, "--");
+
+            if (!option->expectsValue) {
+                int count = override != nullptr ? override->count :
+                    option->source > Source::Default ? option->count : 0;
+                if (count > 0 && isLong) {
+                    for (int i = 0; i < count; i++) {
+                        token(name.data(), name.size());
+                        finish();
+                    }
+                } else if (count > 0) {
+                    token("-", 1);
+                    for (int i = 0; i < count; i++) {
+                        append(&name[1], 1);
+                    }
+                    finish();
+                }
+                continue;
+            }
+
+            if (override == nullptr && option->source == Source::Default) {
+                continue;
+            }
+            const auto& data = valuesOf(*option);
+            size_t valueCount = override != nullptr ?
+                override->values.size() : data.valueCount();
+            for (size_t i = 0; i < valueCount; i++) {
+                token(name.data(), name.size());
+                if (isLong) {
+                    append("=", 1);
+                } else {
+                    finish();
+                    token("", 0);
+                }
+                if (override != nullptr) {
+                    append(
+                        override->values[i].data(),
+                        override->values[i].size());
+                } else {
+                    size += data.formatValue(
+                        i, chars != nullptr ? chars + size : nullptr);
+                }
+                finish();
+            }
+        }
+
+        bool needsSeparator = false;
+        for (const auto& arg : _args) {
+            needsSeparator = needsSeparator ||
+                (arg.size() > 1 && arg.front() == '-');
+        }
+        if (needsSeparator) {
+            token("--", 2);
+            finish();
+        }
+        for (const auto& arg : _args) {
+            token(arg.data(), arg.size());
+            finish();
+        }
+
+        if (pass == 0) {
+            size_t slots =
+                argc + 1 + (size + sizeof(char*) - 1) / sizeof(char*);
+            result._argv.reset(new char*[slots]);
+            result._argc = static_cast<int>(argc);
+            pointers = result._argv.get();
+            pointers[argc] = nullptr;
+            chars = reinterpret_cast<char*>(pointers + argc + 1);
+        }
+    }
+
+    return result;
+}
+
+AA_INLINE Parser::Reloader::Reloader(
+        std::vector<std::string> paths,
+        std::vector<std::shared_ptr<OptionInfo>> options,
+        internal::NameTable<OptionInfo*> table,
+        bool printErrors)
+    : paths(std::move(paths))
+    , options(std::move(options))
+    , table(std::move(table))
+    , printErrors(printErrors)
+{
+    // Sources are copied here, since parse() may change them on another
+    // thread while the watcher reloads.
+    for (const auto& option : this->options) {
+        reloadable.push_back(option->expectsValue &&
+            option->source <= Source::ConfigFile);
+    }
+}
+
+AA_INLINE Parser::Reloader::~Reloader() = default;
+
+AA_INLINE void Parser::Reloader::watch()
+{
+    watcher.reset(new internal::FileWatcher{paths, [this] {
+        reload();
+    }});
+}
+
+AA_INLINE void Parser::Reloader::reload()
+{
+    std::lock_guard<std::mutex> lock{mutex};
+    auto raw = std::vector<std::vector<std::string>>(options.size());
+    auto errors = std::string{};
+
+    for (const auto& path : paths) {
+        internal::MappedFile file{path};
+        if (!file.open()) {
+            continue;
+        }
+
+        auto entry = [&] (
+                const char* key,
+                size_t keySize,
+                const std::string& value) -> const char*
+        {
+            auto found = table.find(key, keySize);
+            if (found == nullptr) {
+                return "unknown option";
+            }
+            auto& option = **found;
+            if (reloadable[option.index]) {
+                if (!valuesOf(option).accepts(value)) {
+                    return "invalid value";
+                }
+                raw[option.index].push_back(value);
+            }
+            return nullptr;
+        };
+        auto error = [&] (
+            size_t line,
+            const char* message,
+            const char* p,
+            const char* q)
+        {
+            auto diagnostic = Diagnostic{};
+            diagnostic.code = ErrorCode::ConfigFile;
+            diagnostic.text = path;
+            diagnostic.number = static_cast<long long>(line);
+            diagnostic.reason = message;
+            diagnostic.detail.assign(p, q);
+            diagnostic.format(errors);
+            errors += '\n';
+        };
+        internal::parseConfig(
+            file.data(), file.data() + file.size(), entry, error);
+    }
+
+    if (!errors.empty()) {
+        if (printErrors) {
+            std::fputs(errors.c_str(), stderr);
+        }
+        return;
+    }
+    for (size_t i = 0; i < options.size(); i++) {
+        if (!raw[i].empty()) {
+            valuesOf(*options[i]).publish(raw[i]);
+        }
+    }
+}
+
+AA_INLINE void Parser::watchConfigFiles()
+{
+    _reloader.reset();
+    _reloader.reset(new Reloader{
+        _configFiles, _optionList, configTable(), _printErrors});
+    _reloader->watch();
+}
+
+AA_INLINE void Parser::reloadConfigFiles()
+{
+    if (!_reloader || !_reloader->watcher) {
+        _reloader.reset(new Reloader{
+            _configFiles, _optionList, configTable(), _printErrors});
+    }
+    _reloader->reload();
+}
+
+AA_INLINE std::uint64_t Parser::schemaHash() const
+{
+    auto schema = std::string{};
+    for (const auto& option : _optionList) {
+        schema += internal::join(option->flags, ",");
+        schema += ':';
+        if (option->expectsValue) {
+            valuesOf(*option).typeTag(schema);
+        } else {
+            schema += '-';
+        }
+        schema += ';';
+    }
+    return internal::hash(schema.data(), schema.size());
+}
+
+AA_INLINE const std::string& Parser::argvName(const OptionInfo& option)
+{
+    for (const auto& flag : option.flags) {
+        if (internal::startsWith(flag, "--")) {
+            return flag;
+        }
+    }
+    return option.flags.front();
+}
+
+// A source that replaces an option's values replaces its count as well. Only
+// the command line counts every time an option is given: config files and
+// the environment set it once, however many files set it.
+AA_INLINE void Parser::occurrence(OptionInfo& option, Source from)
+{
+    if (from > option.source) {
+        if (option.expectsValue) {
+            valuesOf(option).clearValues();
+            valuesOf(option).arguments.clear();
+        }
+        option.source = from;
+        option.count = 0;
+    }
+    if (from == Source::CommandLine || option.count == 0) {
+        option.count++;
+    }
+    markSeen(option);
+}
+
+AA_INLINE void Parser::markSeen(OptionInfo& option)
+{
+    if (!option.expectsValue) {
+        static_cast<internal::FlagData&>(option).set(option.count);
+    }
+    auto index = option.index;
+    auto bit = std::uint64_t{1} << (index % 64);
+    if (option.count > 0) {
+        _seen[index / 64] |= bit;
+    } else {
+        _seen[index / 64] &= ~bit;
+    }
+}
+
+AA_INLINE bool Parser::seen(size_t index) const
+{
+    return (_seen[index / 64] >> (index % 64)) & 1;
+}
+
+AA_INLINE std::vector<std::shared_ptr<const OptionInfo>> Parser::listOptions(
+    const std::vector<std::uint64_t>& mask, bool wasSeen) const
+{
+    auto options = std::vector<std::shared_ptr<const OptionInfo>>{};
+    for (size_t i = 0; i < mask.size() * 64; i++) {
+        if ((mask[i / 64] >> (i % 64)) & 1 && seen(i) == wasSeen) {
+            options.push_back(_optionList[i]);
+        }
+    }
+    return options;
+}
+
+AA_INLINE Diagnostic& Parser::diagnose(ErrorCode code, const OptionInfo* option)
+{
+    _diagnostics.emplace_back();
+    auto& diagnostic = _diagnostics.back();
+    diagnostic.code = code;
+    if (option != nullptr) {
+        diagnostic.option = _optionList[option->index];
+    }
+    return diagnostic;
+}
+
+AA_INLINE void Parser::takeErrors(std::string& out)
+{
+    for (const auto& diagnostic : _diagnostics) {
+        diagnostic.format(out);
+        out += '\n';
+    }
+    _diagnostics.clear();
+}
+
+AA_INLINE void Parser::start()
+{
+    _seen.resize((_optionList.size() + 63) / 64);
+    _bulkValues.resize(_optionList.size());
+    _globbed.clear();
+    if (_expandGlobs) {
+        _globbed.resize(_optionList.size() + 1);
+    }
+    _processingFlags = true;
+    _pending = nullptr;
+    _argument = 0;
+    AA_STAT(_parseStart = std::chrono::steady_clock::now());
+}
+
+AA_INLINE void Parser::feed(const char* arg, size_t size)
+{
+    size_t argument = _argument++;
+    AA_STAT(_stats.tokens++);
+
+    if (_pending != nullptr) {
+        auto& option = *_pending;
+        _pending = nullptr;
+        value(option, arg, size, _pendingArgument);
+    } else if (!_processingFlags) {
+        positional(arg, size, argument);
+    } else if (size == 2 && arg[0] == '-' && arg[1] == '-') {
+        _processingFlags = false;
+    } else if (size > 2 && arg[0] == '-' && arg[1] == '-') {
+        parseLongOption(arg, size, argument);
+    } else if (size > 1 && arg[0] == '-') {
+        parseShortOption(arg, size, argument);
+    } else {
+        positional(arg, size, argument);
+    }
+}
+
+AA_INLINE void Parser::finish()
+{
+    if (_pending != nullptr) {
+        diagnose(ErrorCode::MissingValue, _pending);
+        _pending = nullptr;
+    }
+
+    convertBulkValues();
+    loadConfigFiles();
+    resolveEnvironment();
+    runChecks();
+    checkRestrictions();
+
+    AA_STAT(_stats.errors += _diagnostics.size());
+    AA_STAT(_stats.parseTime += std::chrono::duration_cast<
+        std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - _parseStart));
+    if (!_diagnostics.empty()) {
+        auto error = ParseError{
+            std::move(_diagnostics), __FILE__, __LINE__, __func__};
+        _diagnostics.clear();
+        if (_printErrors) {
+            _errorText.clear();
+            error.format(_errorText);
+            std::fputs(_errorText.c_str(), stderr);
+        }
+        throw error;
+    }
+}
+
+AA_INLINE void Parser::parseLongOption(const char* arg, size_t size, size_t argument)
+{
+    auto equ = static_cast<const char*>(std::memchr(arg, '=', size));
+    auto keySize = equ != nullptr ? static_cast<size_t>(equ - arg) : size;
+
+    auto found = _longOptions.find(arg, keySize);
+    if (found == nullptr) {
+        diagnose(ErrorCode::UnknownOption).text.assign(arg, keySize);
+        return;
+    }
+    auto& option = **found;
+
+    if (!option.expectsValue && equ != nullptr) {
+        diagnose(ErrorCode::UnexpectedValue).text.assign(arg, keySize);
+        return;
+    }
+
+    AA_STAT(_stats.longOptions++);
+    occurrence(option, Source::CommandLine);
+    if (!option.expectsValue) {
+        flagEvent(option, argument);
+    } else if (equ != nullptr) {
+        value(valuesOf(option), equ + 1, size - keySize - 1, argument);
+    } else {
+        _pending = &valuesOf(option);
+        _pendingArgument = argument;
+    }
+}
+
+AA_INLINE void Parser::parseShortOption(const char* arg, size_t size, size_t argument)
+{
+    for (size_t i = 1; i < size; i++) {
+        char key = arg[i];
+
+        auto optionItr = _shortOptions.find(key);
+        if (optionItr == _shortOptions.end()) {
+            auto& diagnostic = diagnose(ErrorCode::UnknownShortOption);
+            diagnostic.detail.assign(1, key);
+            diagnostic.text.assign(arg, size);
+            return;
+        }
+        auto& option = *optionItr->second;
+
+        AA_STAT(_stats.shortOptions++);
+        AA_STAT(_stats.bundledOptions += i > 1);
+        occurrence(option, Source::CommandLine);
+        if (!option.expectsValue) {
+            flagEvent(option, argument);
+            continue;
+        }
+
+        if (i + 1 < size) {
+            value(valuesOf(option), arg + i + 1, size - i - 1, argument);
+        } else {
+            _pending = &valuesOf(option);
+            _pendingArgument = argument;
+        }
+        return;
+    }
+}
+
+AA_INLINE void Parser::value(
+    OptionData& option, const char* data, size_t size, size_t argument)
+{
+    if (&option == _argsFrom) {
+        readArgs(std::string(data, size));
+        return;
+    }
+    if (_expandGlobs && option.namesFiles) {
+        auto matches = std::vector<View>{};
+        if (expandGlob(&option, data, size, matches)) {
+            for (const auto& match : matches) {
+                storeValue(option, match.data, match.size, argument);
+            }
+            return;
+        }
+    }
+    storeValue(option, data, size, argument);
+}
+
+AA_INLINE void Parser::storeValue(
+    OptionData& option, const char* data, size_t size, size_t argument)
+{
+    if (_listener) {
+        _listener(Event{
+            Event::Option, option.index, View{data, size}, argument});
+    } else if (option.count > 0 &&
+            static_cast<size_t>(option.count) > _parallelThreshold &&
+            !option.keepLast) {
+        // Arguments read from files live in a buffer that is reused.
+        if (_argsFromDepth > 0) {
+            _heldArgs.emplace_back(data, size);
+            data = _heldArgs.back().data();
+        }
+        _bulkValues[option.index].push_back(View{data, size});
+        if (option.checked) {
+            option.arguments.push_back(argument);
+        }
+    } else {
+        auto string = std::string(data, size);
+        if (!option.supply(string, Source::CommandLine)) {
+            invalidValue(option, string);
+        } else if (option.checked) {
+            if (option.keepLast && !option.arguments.empty()) {
+                option.arguments.back() = argument;
+            } else {
+                option.arguments.push_back(argument);
+            }
+        }
+    }
+}
+
+AA_INLINE void Parser::invalidValue(
+    const OptionData& option, const std::string& value)
+{
+    auto code = option.choices.empty() ?
+        ErrorCode::InvalidValue : ErrorCode::InvalidChoice;
+    diagnose(code, &option).text = value;
+}
+
+AA_INLINE void Parser::convertBulkValues()
+{
+    auto threads = _parallelThreads > 0 ?
+        _parallelThreads : internal::defaultThreads();
+    auto rejected = std::vector<size_t>{};
+    for (const auto& info : _optionList) {
+        auto& bulk = _bulkValues[info->index];
+        if (bulk.empty()) {
+            continue;
+        }
+        auto option = &valuesOf(*info);
+        // Arguments were only recorded for these values, so they stay.
+        if (option->source < Source::CommandLine) {
+            option->clearValues();
+            option->source = Source::CommandLine;
+        }
+        // Each thread gets at least a thousand values or so.
+        auto useful = std::max<size_t>(bulk.size() / 1024, 1);
+        rejected.clear();
+        option->parseValues(
+            bulk, static_cast<unsigned>(std::min<size_t>(threads, useful)),
+            rejected);
+        for (auto i : rejected) {
+            invalidValue(*option, bulk[i].str());
+        }
+        if (option->checked && !rejected.empty()) {
+            auto& arguments = option->arguments;
+            auto base = arguments.size() - bulk.size();
+            auto out = base;
+            size_t next = 0;
+            for (size_t i = 0; i < bulk.size(); i++) {
+                if (next < rejected.size() && rejected[next] == i) {
+                    next++;
+                } else {
+                    arguments[out++] = arguments[base + i];
+                }
+            }
+            arguments.resize(out);
+        }
+        std::vector<View>{}.swap(bulk);
+    }
+    _heldArgs.clear();
+}
+
+AA_INLINE bool Parser::expandGlob(
+    const OptionData* option,
+    const char* data,
+    size_t size,
+    std::vector<View>& matches)
+{
+    auto found = std::vector<std::string>{};
+    auto threads = _globThreads > 0 ? _globThreads : internal::ioThreads();
+    if (!internal::isGlob(data, size) ||
+            !internal::expandGlob(std::string(data, size), threads, found)) {
+        auto unescaped = std::string{};
+        if (!internal::unescapeGlob(data, size, unescaped)) {
+            return false;
+        }
+        _heldArgs.push_back(std::move(unescaped));
+        const auto& held = _heldArgs.back();
+        matches.push_back(View{held.data(), held.size()});
+        return true;
+    }
+    auto& kept = _globbed[option != nullptr ?
+        option->index : _optionList.size()];
+    for (auto& path : found) {
+        if (kept.insert(path).second) {
+            _heldArgs.push_back(std::move(path));
+            const auto& held = _heldArgs.back();
+            matches.push_back(View{held.data(), held.size()});
+        }
+    }
+    return true;
+}
+
+AA_INLINE void Parser::readArgs(const std::string& path)
+{
+    if (_argsFromDepth >= 16) {
+        diagnose(ErrorCode::NestedTooDeeply).text = path;
+        return;
+    }
+
+    internal::InputFile file{path};
+    if (file.fd() < 0) {
+        diagnose(ErrorCode::CannotOpen).text = path;
+        return;
+    }
+
+    bool nul = _argsFromNul != nullptr && _argsFromNul->count > 0;
+    auto reader = internal::TokenReader{file.fd(), nul ? '\0' : '\n'};
+    const char* token = nullptr;
+    size_t size = 0;
+
+    _argsFromDepth++;
+    while (reader.next(token, size)) {
+        if (size > 0 || nul) {
+            feed(token, size);
+        }
+    }
+    _argsFromDepth--;
+}
+
+AA_INLINE void Parser::flagEvent(const OptionInfo& option, size_t argument)
+{
+    if (_listener) {
+        _listener(Event{
+            Event::Option, option.index, View{nullptr, 0}, argument});
+    }
+}
+
+AA_INLINE void Parser::positional(const char* data, size_t size, size_t argument)
+{
+    if (_expandGlobs) {
+        auto matches = std::vector<View>{};
+        if (expandGlob(nullptr, data, size, matches)) {
+            for (const auto& match : matches) {
+                storePositional(match.data, match.size, argument);
+            }
+            return;
+        }
+    }
+    storePositional(data, size, argument);
+}
+
+AA_INLINE void Parser::storePositional(
+    const char* data, size_t size, size_t argument)
+{
+    AA_STAT(_stats.positionals++);
+    if (_listener) {
+        _listener(Event{
+            Event::Positional, 0, View{data, size}, argument});
+    } else {
+        _args.emplace_back(data, size);
+    }
+}
+
+AA_INLINE void Parser::loadConfigFiles()
+{
+    if (_configFiles.empty()) {
+        return;
+    }
+
+    auto table = configTable();
+    for (const auto& path : _configFiles) {
+        internal::MappedFile file{path};
+        if (!file.open()) {
+            continue;
+        }
+
+        auto entry = [&] (
+                const char* key, size_t keySize, const std::string& value)
+            -> const char*
+        {
+            auto found = table.find(key, keySize);
+            if (found == nullptr) {
+                return "unknown option";
+            }
+            auto& option = **found;
+
+            if (option.source > Source::ConfigFile) {
+                return nullptr;
+            }
+            if (option.expectsValue) {
+                occurrence(option, Source::ConfigFile);
+                if (!valuesOf(option).supply(value, Source::ConfigFile)) {
+                    return "invalid value";
+                }
+                return nullptr;
+            }
+
+            int count = flagCount(value);
+            if (count < 0) {
+                return "malformed flag value";
+            }
+            option.source = Source::ConfigFile;
+            option.count = count;
+            markSeen(option);
+            return nullptr;
+        };
+        auto error = [&] (
+            size_t line, const char* message, const char* p, const char* q)
+        {
+            auto& diagnostic = diagnose(ErrorCode::ConfigFile);
+            diagnostic.text = path;
+            diagnostic.number = static_cast<long long>(line);
+            diagnostic.reason = message;
+            diagnostic.detail.assign(p, q);
+        };
+        internal::parseConfig(
+            file.data(), file.data() + file.size(), entry, error);
+    }
+}
+
+AA_INLINE internal::NameTable<OptionInfo*> Parser::configTable() const
+{
+    auto table = internal::NameTable<OptionInfo*>{};
+    for (const auto& option : _optionList) {
+        for (const auto& flag : option->flags) {
+            if (internal::startsWith(flag, "--")) {
+                table.insert(flag.substr(2), option.get());
+            }
+        }
+    }
+    return table;
+}
+
+AA_INLINE int Parser::flagCount(const std::string& value)
+{
+    if (value == "true" || value == "yes" || value == "on") {
+        return 1;
+    }
+    if (value == "false" || value == "no" || value == "off") {
+        return 0;
+    }
+    if (value.empty() ||
+            value.find_first_not_of("0123456789") != std::string::npos) {
+        return -1;
+    }
+    return internal::fromString<int>(value);
+}
+
+AA_INLINE void Parser::resolveEnvironment()
+{
+    // Several options may read the same variable.
+    auto table = internal::NameTable<std::vector<OptionData*>>{};
+    for (const auto& info : _optionList) {
+        if (!info->expectsValue) {
+            continue;
+        }
+        auto& option = valuesOf(*info);
+        if (option.env.empty() || option.source >= Source::Environment) {
+            continue;
+        }
+        auto found = table.find(option.env.data(), option.env.size());
+        if (found != nullptr) {
+            found->push_back(&option);
+        } else {
+            table.insert(option.env, {&option});
+        }
+    }
+    if (table.empty()) {
+        return;
+    }
+
+    for (char** entry = internal::environment(); entry && *entry; ++entry) {
+        const char* equ = std::strchr(*entry, '=');
+        if (equ == nullptr) {
+            continue;
+        }
+
+        auto options = table.find(*entry, equ - *entry);
+        if (options == nullptr) {
+            continue;
+        }
+        for (auto option : *options) {
+            occurrence(*option, Source::Environment);
+            if (!option->supply(equ + 1, Source::Environment)) {
+                invalidValue(*option, equ + 1);
+            }
+        }
+    }
+}
+
+AA_INLINE void Parser::runChecks()
+{
+    auto failures = std::vector<internal::Failure>{};
+    for (const auto& info : _optionList) {
+        if (!info->expectsValue) {
+            continue;
+        }
+        auto option = &valuesOf(*info);
+        if (!option->checked || option->source == Source::Default) {
+            continue;
+        }
+        failures.clear();
+        option->checkValues(0, option->valueCount(), failures);
+        std::stable_sort(failures.begin(), failures.end(),
+            [] (const internal::Failure& lhs, const internal::Failure& rhs) {
+                return lhs.value < rhs.value;
+            });
+
+        // Values from the environment or config files have no argument.
+        const auto& arguments = option->arguments;
+        bool located = arguments.size() == option->valueCount();
+        for (const auto& failure : failures) {
+            auto& diagnostic = failedCheck(
+                *option, failure.value, *failure.expected, located);
+            if (located) {
+                diagnostic.number =
+                    static_cast<long long>(arguments[failure.value]) + 1;
+            }
+        }
+    }
+}
+
+AA_INLINE Diagnostic& Parser::failedCheck(
+    const OptionData& option, size_t value, const std::string& expected,
+    bool located)
+{
+    auto& diagnostic = diagnose(
+        located ? ErrorCode::FailedCheckAt : ErrorCode::FailedCheck, &option);
+    auto& text = diagnostic.text;
+    text.resize(option.formatValue(value, nullptr));
+    option.formatValue(value, &text[0]);
+    diagnostic.detail = expected;
+    return diagnostic;
+}
+
+AA_INLINE void Parser::checkRestrictions()
+{
+    for (const auto& option : _optionList) {
+        if (option->required && option->count == 0) {
+            diagnose(ErrorCode::Required, option.get());
+        }
+    }
+
+    for (const auto& restriction : _restrictions) {
+        const auto& mask = restriction.mask;
+
+        switch (restriction.kind) {
+            case Restriction::Exclusive: {
+                int seenCount = 0;
+                for (size_t i = 0; i < mask.size(); i++) {
+                    auto word = _seen[i] & mask[i];
+                    seenCount += (word != 0) + ((word & (word - 1)) != 0);
+                }
+                if (seenCount > 1) {
+                    diagnose(ErrorCode::Exclusive).options =
+                        listOptions(mask, true);
+                }
+                break;
+            }
+            case Restriction::AtLeastOne: {
+                std::uint64_t any = 0;
+                for (size_t i = 0; i < mask.size(); i++) {
+                    any |= _seen[i] & mask[i];
+                }
+                if (!any) {
+                    diagnose(ErrorCode::AtLeastOne).options =
+                        listOptions(mask, false);
+                }
+                break;
+            }
+            case Restriction::Implies: {
+                if (!seen(restriction.subject)) {
+                    break;
+                }
+                std::uint64_t missing = 0;
+                for (size_t i = 0; i < mask.size(); i++) {
+                    missing |= mask[i] & ~_seen[i];
+                }
+                if (missing) {
+                    diagnose(
+                        ErrorCode::Implies,
+                        _optionList[restriction.subject].get()).options =
+                            listOptions(mask, false);
+                }
+                break;
+            }
+            case Restriction::Occurrences: {
+                const auto& option = *_optionList[restriction.subject];
+                if (option.count < restriction.min) {
+                    diagnose(ErrorCode::TooFew, &option).number =
+                        restriction.min;
+                } else if (option.count > restriction.max) {
+                    diagnose(ErrorCode::TooMany, &option).number =
+                        restriction.max;
+                }
+                break;
+            }
+        }
+    }
+}
+
+AA_INLINE std::uint64_t Parser::trackedOrder(size_t index)
+{
+    const auto gap = std::uint64_t{1} << 32;
+    auto& args = _tracker->args;
+    for (;;) {
+        auto previous = index > 0 ? args[index - 1]->order : 0;
+        auto next = index < args.size() ?
+            args[index]->order : previous + 2 * gap;
+        if (next > previous + 1) {
+            return previous + (next - previous) / 2;
+        }
+        for (size_t i = 0; i < args.size(); i++) {
+            args[i]->order = (i + 1) * gap;
+        }
+    }
+}
+
+AA_INLINE void Parser::classify(TrackedArg& arg)
+{
+    AA_STAT(_stats.tokens++);
+    arg.occurrences.clear();
+    arg.valueOf = nullptr;
+    arg.hasValue = false;
+    arg.valueStart = 0;
+    arg.converted.reset();
+
+    auto state = arg.before;
+    const char* data = arg.text.data();
+    size_t size = arg.text.size();
+
+    // Values are converted here, so that rejected ones are reported by the
+    // argument that holds them, and stored from what was converted.
+    auto value = [&] (OptionData& option, size_t start) {
+        arg.converted = option.convertValue(data + start, size - start);
+        if (arg.converted) {
+            arg.valueOf = &option;
+            arg.hasValue = true;
+            arg.valueStart = start;
+        } else {
+            invalidValue(option, arg.text.substr(start));
+        }
+    };
+
+    if (state.pending != nullptr) {
+        value(*state.pending, 0);
+        state.pending = nullptr;
+    } else if (!state.processingFlags) {
+        arg.hasValue = true;
+    } else if (size == 2 && data[0] == '-' && data[1] == '-') {
+        state.processingFlags = false;
+    } else if (size > 2 && data[0] == '-' && data[1] == '-') {
+        auto equ = static_cast<const char*>(std::memchr(data, '=', size));
+        auto keySize = equ != nullptr ? static_cast<size_t>(equ - data) : size;
+        auto found = _longOptions.find(data, keySize);
+        if (found == nullptr) {
+            diagnose(ErrorCode::UnknownOption).text.assign(data, keySize);
+        } else if (!(*found)->expectsValue && equ != nullptr) {
+            diagnose(ErrorCode::UnexpectedValue).text.assign(data, keySize);
+        } else {
+            auto& option = **found;
+            arg.occurrences.push_back(&option);
+            if (option.expectsValue && equ != nullptr) {
+                value(valuesOf(option), keySize + 1);
+            } else if (option.expectsValue) {
+                state.pending = &valuesOf(option);
+            }
+        }
+    } else if (size > 1 && data[0] == '-') {
+        for (size_t i = 1; i < size; i++) {
+            auto optionItr = _shortOptions.find(data[i]);
+            if (optionItr == _shortOptions.end()) {
+                auto& diagnostic = diagnose(ErrorCode::UnknownShortOption);
+                diagnostic.detail.assign(1, data[i]);
+                diagnostic.text = arg.text;
+                break;
+            }
+            auto& option = *optionItr->second;
+            arg.occurrences.push_back(&option);
+            if (!option.expectsValue) {
+                continue;
+            }
+            if (i + 1 < size) {
+                value(valuesOf(option), i + 1);
+            } else {
+                state.pending = &valuesOf(option);
+            }
+            break;
+        }
+    } else {
+        arg.hasValue = true;
+    }
+
+    arg.after = state;
+    arg.error.clear();
+    takeErrors(arg.error);
+}
+
+AA_INLINE void Parser::contribute(const TrackedArg& arg, int sign)
+{
+    auto& tracker = *_tracker;
+
+    for (auto option : arg.occurrences) {
+        auto index = option->index;
+        auto& count = tracker.counts[index];
+        count += sign;
+        // Options that come onto the command line or leave it switch between
+        // its values and their fallback, which takes a rebuild.
+        if (tracker.dirty[index] || count == 0 || (sign > 0 && count == 1)) {
+            markDirty(index);
+        } else {
+            option->count = count;
+            markSeen(*option);
+        }
+    }
+
+    if (arg.hasValue) {
+        auto& list = arg.valueOf != nullptr ?
+            tracker.values[arg.valueOf->index] : tracker.positionals;
+        auto position = std::lower_bound(
+            list.begin(), list.end(), &arg, ByOrder{});
+        auto at = static_cast<size_t>(position - list.begin());
+        if (sign > 0) {
+            list.insert(position, &arg);
+        } else {
+            list.erase(position);
+        }
+
+        if (arg.valueOf == nullptr) {
+            if (sign > 0) {
+                _args.insert(
+                    _args.begin() + at, arg.text.substr(arg.valueStart));
+            } else {
+                _args.erase(_args.begin() + at);
+            }
+        } else {
+            auto& option = *arg.valueOf;
+            if (sign < 0) {
+                tracker.checkFailed[option.index].erase(&arg);
+            }
+            if (tracker.dirty[option.index] || option.keepLast ||
+                    option.source != Source::CommandLine) {
+                markDirty(option.index);
+            } else if (sign > 0) {
+                option.insertValue(at, arg.converted.get());
+                if (option.checked) {
+                    checkTracked(option, at, at + 1);
+                }
+            } else {
+                option.eraseValue(at);
+            }
+        }
+    }
+
+    if (!arg.error.empty()) {
+        if (sign > 0) {
+            tracker.failed.insert(&arg);
+        } else {
+            tracker.failed.erase(&arg);
+        }
+    }
+}
+
+AA_INLINE void Parser::retrack(size_t index, TrackedArg::State before)
+{
+    auto& args = _tracker->args;
+    for (; index < args.size() && !(args[index]->before == before); index++) {
+        auto& arg = *args[index];
+        contribute(arg, -1);
+        arg.before = before;
+        classify(arg);
+        contribute(arg, 1);
+        before = arg.after;
+    }
+}
+
+AA_INLINE void Parser::markDirty(size_t index)
+{
+    auto& tracker = *_tracker;
+    if (!tracker.dirty[index]) {
+        tracker.dirty[index] = true;
+        tracker.dirtyList.push_back(index);
+    }
+}
+
+AA_INLINE void Parser::refresh(OptionInfo& info)
+{
+    auto& tracker = *_tracker;
+    auto index = info.index;
+    auto count = tracker.counts[index];
+    tracker.checkFailed[index].clear();
+
+    if (count == 0) {
+        const auto& fallback = tracker.fallback[index];
+        if (info.expectsValue) {
+            valuesOf(info).assignValues(*fallback.values);
+        }
+        info.count = fallback.count;
+        info.source = fallback.source;
+    } else {
+        info.count = count;
+        info.source = Source::CommandLine;
+        if (info.expectsValue) {
+            auto& option = valuesOf(info);
+            const auto& list = tracker.values[index];
+            auto first = option.keepLast && !list.empty() ?
+                list.end() - 1 : list.begin();
+            option.clearValues();
+            for (auto arg = first; arg != list.end(); ++arg) {
+                option.insertValue(
+                    option.valueCount(), (*arg)->converted.get());
+            }
+            if (option.checked) {
+                checkTracked(option, 0, option.valueCount());
+            }
+        }
+    }
+    markSeen(info);
+}
+
+// Values are held by the last arguments of the option, since only the last
+// one is kept for keepLast().
+AA_INLINE void Parser::checkTracked(
+    const OptionData& option, size_t begin, size_t end)
+{
+    auto& tracker = *_tracker;
+    const auto& list = tracker.values[option.index];
+    auto offset = list.size() - option.valueCount();
+    auto failures = std::vector<internal::Failure>{};
+    option.checkValues(begin, end, failures);
+    for (const auto& failure : failures) {
+        tracker.checkFailed[option.index][list[offset + failure.value]]
+            .push_back(failure.expected);
+    }
+}
+
+AA_INLINE size_t Parser::trackedArgument(
+    const TrackedArg& arg, const OptionData& option) const
+{
+    const auto& args = _tracker->args;
+    auto found = std::lower_bound(args.begin(), args.end(), arg.order,
+        [] (const std::unique_ptr<TrackedArg>& lhs, std::uint64_t order) {
+            return lhs->order < order;
+        });
+    auto position = static_cast<size_t>(found - args.begin());
+    // Values in an argument of their own belong to the option before it.
+    if (arg.valueStart == 0 && arg.before.pending == &option) {
+        position--;
+    }
+    return position;
+}
+
+AA_INLINE void Parser::trackedChecks()
+{
+    const auto& tracker = *_tracker;
+    for (const auto& info : _optionList) {
+        if (!info->expectsValue) {
+            continue;
+        }
+        auto option = &valuesOf(*info);
+        auto index = option->index;
+        if (tracker.counts[index] == 0) {
+            for (const auto& failure : tracker.fallbackFailed[index]) {
+                failedCheck(
+                    *option, failure.value, *failure.expected, false);
+            }
+            continue;
+        }
+        const auto& list = tracker.values[index];
+        auto offset = list.size() - option->valueCount();
+        for (const auto& failed : tracker.checkFailed[index]) {
+            auto value = static_cast<size_t>(std::lower_bound(
+                list.begin(), list.end(), failed.first, ByOrder{}) -
+                list.begin()) - offset;
+            auto argument = trackedArgument(*failed.first, *option);
+            for (auto expected : failed.second) {
+                failedCheck(*option, value, *expected, true).number =
+                    static_cast<long long>(argument) + 1;
+            }
+        }
+    }
+}
+
+AA_INLINE std::string Parser::trackedErrors()
+{
+    auto& tracker = *_tracker;
+    for (auto index : tracker.dirtyList) {
+        refresh(*_optionList[index]);
+        tracker.dirty[index] = false;
+    }
+    tracker.dirtyList.clear();
+
+    auto errors = std::string{};
+    for (auto arg : tracker.failed) {
+        errors += arg->error;
+    }
+    if (!tracker.args.empty()) {
+        auto pending = tracker.args.back()->after.pending;
+        if (pending != nullptr) {
+            diagnose(ErrorCode::MissingValue, pending);
+            takeErrors(errors);
+        }
+    }
+    errors += tracker.sourceErrors;
+
+    trackedChecks();
+    checkRestrictions();
+    takeErrors(errors);
+    return errors;
+}
+
+} // namespace aa
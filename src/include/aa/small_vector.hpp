@@ -0,0 +1,329 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <initializer_list>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace aa {
+
+// A vector that keeps its first N elements inside the object, and moves them
+// to the heap only when more are added. Option values use it, since almost
+// all options are given once.
+template <class T, size_t N>
+class SmallVector {
+public:
+    using value_type = T;
+    using size_type = size_t;
+    using reference = T&;
+    using const_reference = const T&;
+    using iterator = T*;
+    using const_iterator = const T*;
+
+    SmallVector() = default;
+
+    SmallVector(std::initializer_list<T> values)
+    {
+        reserve(values.size());
+        for (const auto& value : values) {
+            push_back(value);
+        }
+    }
+
+    SmallVector(const SmallVector& other)
+    {
+        reserve(other.size());
+        for (const auto& value : other) {
+            push_back(value);
+        }
+    }
+
+    // Moving inline elements moves each of them, so it only throws if that
+    // does. Containers of SmallVector move them when growing if it does not.
+    SmallVector(SmallVector&& other) noexcept(
+        std::is_nothrow_move_constructible<T>::value)
+    {
+        take(other);
+    }
+
+    ~SmallVector()
+    {
+        clear();
+        release();
+    }
+
+    SmallVector& operator=(const SmallVector& other)
+    {
+        if (this != &other) {
+            clear();
+            reserve(other.size());
+            for (const auto& value : other) {
+                push_back(value);
+            }
+        }
+        return *this;
+    }
+
+    SmallVector& operator=(SmallVector&& other) noexcept(
+        std::is_nothrow_move_constructible<T>::value)
+    {
+        if (this != &other) {
+            clear();
+            release();
+            take(other);
+        }
+        return *this;
+    }
+
+    operator std::vector<T>() const
+    {
+        return std::vector<T>(begin(), end());
+    }
+
+    size_t size() const
+    {
+        return _size;
+    }
+
+    size_t capacity() const
+    {
+        return _capacity;
+    }
+
+    bool empty() const
+    {
+        return _size == 0;
+    }
+
+    T* data()
+    {
+        return _data;
+    }
+
+    const T* data() const
+    {
+        return _data;
+    }
+
+    T* begin()
+    {
+        return _data;
+    }
+
+    const T* begin() const
+    {
+        return _data;
+    }
+
+    T* end()
+    {
+        return _data + _size;
+    }
+
+    const T* end() const
+    {
+        return _data + _size;
+    }
+
+    T& operator[](size_t i)
+    {
+        return _data[i];
+    }
+
+    const T& operator[](size_t i) const
+    {
+        return _data[i];
+    }
+
+    T& front()
+    {
+        return _data[0];
+    }
+
+    const T& front() const
+    {
+        return _data[0];
+    }
+
+    T& back()
+    {
+        return _data[_size - 1];
+    }
+
+    const T& back() const
+    {
+        return _data[_size - 1];
+    }
+
+    void reserve(size_t capacity)
+    {
+        if (capacity > _capacity) {
+            relocate(allocate(capacity), capacity);
+        }
+    }
+
+    void push_back(const T& value)
+    {
+        emplace_back(value);
+    }
+
+    void push_back(T&& value)
+    {
+        emplace_back(std::move(value));
+    }
+
+    template <class... Args>
+    T& emplace_back(Args&&... args)
+    {
+        if (_size < _capacity) {
+            new (_data + _size) T(std::forward<Args>(args)...);
+        } else {
+            // The new element is constructed first, since args may refer to
+            // elements that are about to move.
+            auto capacity = _capacity * 2;
+            auto buffer = allocate(capacity);
+            try {
+                new (buffer + _size) T(std::forward<Args>(args)...);
+            } catch (...) {
+                ::operator delete(buffer);
+                throw;
+            }
+            relocate(buffer, capacity);
+        }
+        return _data[_size++];
+    }
+
+    T* insert(const T* position, T value)
+    {
+        auto offset = position - _data;
+        emplace_back(std::move(value));
+        for (auto i = _size - 1; i > size_t(offset); --i) {
+            using std::swap;
+            swap(_data[i], _data[i - 1]);
+        }
+        return _data + offset;
+    }
+
+    T* erase(const T* position)
+    {
+        auto at = _data + (position - _data);
+        std::move(at + 1, end(), at);
+        _data[--_size].~T();
+        return at;
+    }
+
+    void resize(size_t size)
+    {
+        reserve(size);
+        while (_size < size) {
+            emplace_back();
+        }
+        while (_size > size) {
+            _data[--_size].~T();
+        }
+    }
+
+    void clear()
+    {
+        resize(0);
+    }
+
+private:
+    T* inlineData()
+    {
+        return reinterpret_cast<T*>(_inline);
+    }
+
+    static T* allocate(size_t capacity)
+    {
+        return static_cast<T*>(::operator new(capacity * sizeof(T)));
+    }
+
+    // Moves the elements into buffer, which becomes the storage.
+    void relocate(T* buffer, size_t capacity)
+    {
+        for (size_t i = 0; i < _size; i++) {
+            new (buffer + i) T(std::move_if_noexcept(_data[i]));
+            _data[i].~T();
+        }
+        release();
+        _data = buffer;
+        _capacity = capacity;
+    }
+
+    void release()
+    {
+        if (_data != inlineData()) {
+            ::operator delete(_data);
+            _data = inlineData();
+            _capacity = N;
+        }
+    }
+
+    void take(SmallVector& other)
+    {
+        if (other._data != other.inlineData()) {
+            _data = other._data;
+            _size = other._size;
+            _capacity = other._capacity;
+            other._data = other.inlineData();
+            other._size = 0;
+            other._capacity = N;
+            return;
+        }
+        for (auto& value : other) {
+            emplace_back(std::move(value));
+        }
+        other.clear();
+    }
+
+    alignas(T) unsigned char _inline[N * sizeof(T)];
+    T* _data = inlineData();
+    size_t _size = 0;
+    size_t _capacity = N;
+};
+
+template <class T, size_t N>
+bool operator==(const SmallVector<T, N>& lhs, const SmallVector<T, N>& rhs)
+{
+    return lhs.size() == rhs.size() &&
+        std::equal(lhs.begin(), lhs.end(), rhs.begin());
+}
+
+template <class T, size_t N>
+bool operator==(const SmallVector<T, N>& lhs, const std::vector<T>& rhs)
+{
+    return lhs.size() == rhs.size() &&
+        std::equal(lhs.begin(), lhs.end(), rhs.begin());
+}
+
+template <class T, size_t N>
+bool operator==(const std::vector<T>& lhs, const SmallVector<T, N>& rhs)
+{
+    return rhs == lhs;
+}
+
+template <class T, size_t N, class Other>
+bool operator!=(const SmallVector<T, N>& lhs, const Other& rhs)
+{
+    return !(lhs == rhs);
+}
+
+namespace internal {
+
+// Values kept inline per option: as many as fit in 32 bytes, and at least one.
+constexpr size_t inlineValues(size_t size)
+{
+    return size >= 32 ? 1 : 32 / size;
+}
+
+} // namespace internal
+
+// Values of an option, as returned by Option<T>::all().
+template <class T>
+using Values = SmallVector<T, internal::inlineValues(sizeof(T))>;
+
+} // namespace aa
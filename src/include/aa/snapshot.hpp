@@ -0,0 +1,170 @@
+#pragma once
+
+#include "error.hpp"
+#include "small_vector.hpp"
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace aa {
+namespace internal {
+
+// Snapshots are plain byte strings: fixed-size fields in native byte order
+// and length-prefixed arrays, without pointers or offsets, so that a snapshot
+// can be loaded from any address by the binary that wrote it.
+
+// First bytes of every snapshot, ending with the format version.
+const char snapshotMagic[] = "aasnap\x00\x01";
+const size_t snapshotMagicSize = sizeof(snapshotMagic) - 1;
+
+template <class T>
+void put(std::string& out, T value)
+{
+    out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+template <class T>
+const char* get(const char* p, const char* end, T& value)
+{
+    if (static_cast<size_t>(end - p) < sizeof(value)) {
+        FAIL("truncated snapshot");
+    }
+    std::memcpy(&value, p, sizeof(value));
+    return p + sizeof(value);
+}
+
+inline void putString(std::string& out, const std::string& string)
+{
+    put<std::uint64_t>(out, string.size());
+    out.append(string);
+}
+
+inline const char* getString(
+    const char* p, const char* end, std::string& string)
+{
+    auto size = std::uint64_t{};
+    p = get(p, end, size);
+    if (static_cast<std::uint64_t>(end - p) < size) {
+        FAIL("truncated snapshot");
+    }
+    string.assign(p, static_cast<size_t>(size));
+    return p + size;
+}
+
+template <class T, class = void>
+struct Codec {
+    static void tag(std::string& out)
+    {
+        out += "?" + std::to_string(sizeof(T));
+    }
+
+    static void save(std::string&, const Values<T>&)
+    {
+        FAIL("option values of this type cannot be saved in a snapshot");
+    }
+
+    static const char* load(const char*, const char*, Values<T>&)
+    {
+        FAIL("option values of this type cannot be loaded from a snapshot");
+    }
+};
+
+// Arithmetic and enum values are copied in bulk, one memcpy per option.
+template <class T>
+struct Codec<T, typename std::enable_if<
+        (std::is_arithmetic<T>::value || std::is_enum<T>::value) &&
+        !std::is_same<T, bool>::value>::type> {
+    static void tag(std::string& out)
+    {
+        out += std::is_enum<T>::value ? 'e' :
+            std::is_floating_point<T>::value ? 'f' :
+            std::is_signed<T>::value ? 'i' : 'u';
+        out += std::to_string(sizeof(T));
+    }
+
+    static void save(std::string& out, const Values<T>& values)
+    {
+        put<std::uint64_t>(out, values.size());
+        out.append(
+            reinterpret_cast<const char*>(values.data()),
+            values.size() * sizeof(T));
+    }
+
+    static const char* load(
+        const char* p, const char* end, Values<T>& values)
+    {
+        auto size = std::uint64_t{};
+        p = get(p, end, size);
+        if (static_cast<std::uint64_t>(end - p) / sizeof(T) < size) {
+            FAIL("truncated snapshot");
+        }
+        values.resize(static_cast<size_t>(size));
+        std::memcpy(values.data(), p, values.size() * sizeof(T));
+        return p + values.size() * sizeof(T);
+    }
+};
+
+template <>
+struct Codec<bool> {
+    static void tag(std::string& out)
+    {
+        out += "b";
+    }
+
+    static void save(std::string& out, const Values<bool>& values)
+    {
+        put<std::uint64_t>(out, values.size());
+        for (bool value : values) {
+            out += static_cast<char>(value);
+        }
+    }
+
+    static const char* load(
+        const char* p, const char* end, Values<bool>& values)
+    {
+        auto size = std::uint64_t{};
+        p = get(p, end, size);
+        if (static_cast<std::uint64_t>(end - p) < size) {
+            FAIL("truncated snapshot");
+        }
+        values.resize(static_cast<size_t>(size));
+        for (auto& value : values) {
+            value = *p++ != 0;
+        }
+        return p;
+    }
+};
+
+template <>
+struct Codec<std::string> {
+    static void tag(std::string& out)
+    {
+        out += "s";
+    }
+
+    static void save(std::string& out, const Values<std::string>& values)
+    {
+        put<std::uint64_t>(out, values.size());
+        for (const auto& value : values) {
+            putString(out, value);
+        }
+    }
+
+    static const char* load(
+        const char* p, const char* end, Values<std::string>& values)
+    {
+        auto size = std::uint64_t{};
+        p = get(p, end, size);
+        values.clear();
+        for (std::uint64_t i = 0; i < size; i++) {
+            values.emplace_back();
+            p = getString(p, end, values.back());
+        }
+        return p;
+    }
+};
+
+}} // namespace aa::internal
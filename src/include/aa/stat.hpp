@@ -0,0 +1,364 @@
+#pragma once
+
+#include "parallel.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#include <sys/stat.h>
+
+#if !defined(_WIN32)
+#include <unistd.h>
+#endif
+
+// io_uring is used through its system calls, so that liburing is not needed.
+// Define AA_NO_IO_URING to always use threads instead.
+#if defined(__linux__) && !defined(AA_NO_IO_URING) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#if defined(IORING_FEAT_FAST_POLL) && defined(STATX_TYPE) && \
+    defined(__NR_io_uring_setup)
+#define AA_HAS_IO_URING
+#endif
+#endif
+#endif
+
+namespace aa {
+namespace internal {
+
+// What a path names, as far as checking option values goes.
+struct FileStatus {
+    bool found = false;
+    std::uint32_t mode = 0;
+    std::uint32_t uid = 0;
+    std::uint32_t gid = 0;
+};
+
+#if defined(AA_HAS_IO_URING)
+// A ring of asynchronous statx calls. The kernel runs the ones that block in
+// its own workers, so lookups on slow file systems overlap.
+class StatRing {
+public:
+    explicit StatRing(unsigned entries)
+    {
+        auto params = io_uring_params{};
+        _fd = static_cast<int>(
+            syscall(__NR_io_uring_setup, entries, &params));
+        if (_fd < 0 || !supportsStatx()) {
+            return;
+        }
+
+        _sqSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        _cqSize = params.cq_off.cqes +
+            params.cq_entries * sizeof(io_uring_cqe);
+        bool single = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+        if (single) {
+            _sqSize = _cqSize = std::max(_sqSize, _cqSize);
+        }
+        _sq = map(_sqSize, IORING_OFF_SQ_RING);
+        _cq = single ? _sq : map(_cqSize, IORING_OFF_CQ_RING);
+        _sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+        _sqes = static_cast<io_uring_sqe*>(map(_sqesSize, IORING_OFF_SQES));
+        if (_sq == nullptr || _cq == nullptr || _sqes == nullptr) {
+            return;
+        }
+
+        auto sq = static_cast<char*>(_sq);
+        auto cq = static_cast<char*>(_cq);
+        _sqTail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+        _sqMask = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+        _sqArray = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+        _cqHead = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+        _cqTail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+        _cqMask = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+        _cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+        _entries = params.sq_entries;
+        _buffers.reset(new struct statx[_entries]);
+        _slotPath.resize(_entries);
+        _ready = true;
+    }
+
+    StatRing(const StatRing&) = delete;
+    StatRing& operator=(const StatRing&) = delete;
+
+    ~StatRing()
+    {
+        if (_sqes != nullptr) {
+            munmap(_sqes, _sqesSize);
+        }
+        if (_cq != nullptr && _cq != _sq) {
+            munmap(_cq, _cqSize);
+        }
+        if (_sq != nullptr) {
+            munmap(_sq, _sqSize);
+        }
+        if (_fd >= 0) {
+            close(_fd);
+        }
+    }
+
+    bool ready() const
+    {
+        return _ready;
+    }
+
+    // Requests the kernel has taken and not completed yet.
+    size_t inFlight() const
+    {
+        return _inFlight;
+    }
+
+    // Looks up all the paths, keeping the ring full. Returns false if the
+    // ring stopped working; the caller then has to do it another way. The
+    // requests already taken by the kernel are waited for first, since they
+    // write into the ring's buffers.
+    bool run(const char* const* names, size_t n, FileStatus* out)
+    {
+        return run(names, n, out, [this] (unsigned submit) {
+            return enter(submit);
+        });
+    }
+
+    // Same as above, submitting through the given function, which takes the
+    // number of requests to submit and returns like enter(). Tests pass one
+    // that fails, to see what happens to the requests in flight.
+    template <class Submit>
+    bool run(const char* const* names, size_t n, FileStatus* out, Submit submit)
+    {
+        auto freeSlots = std::vector<unsigned>{};
+        for (unsigned slot = _entries; slot > 0; slot--) {
+            freeSlots.push_back(slot - 1);
+        }
+
+        size_t next = 0;
+        size_t done = 0;
+        unsigned unsubmitted = 0;
+        while (done < n) {
+            auto tail = *_sqTail;
+            while (next < n && !freeSlots.empty()) {
+                auto slot = freeSlots.back();
+                freeSlots.pop_back();
+                _slotPath[slot] = next;
+
+                auto& sqe = _sqes[tail & _sqMask];
+                std::memset(&sqe, 0, sizeof(sqe));
+                sqe.opcode = IORING_OP_STATX;
+                sqe.fd = AT_FDCWD;
+                sqe.addr = reinterpret_cast<std::uintptr_t>(names[next]);
+                sqe.len = STATX_TYPE | STATX_MODE | STATX_UID | STATX_GID;
+                sqe.off = reinterpret_cast<std::uintptr_t>(&_buffers[slot]);
+                sqe.user_data = slot;
+                _sqArray[tail & _sqMask] = tail & _sqMask;
+                tail++;
+                next++;
+                unsubmitted++;
+            }
+            __atomic_store_n(_sqTail, tail, __ATOMIC_RELEASE);
+
+            auto submitted = submit(unsubmitted);
+            if (submitted < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                drain();
+                return false;
+            }
+            unsubmitted -= static_cast<unsigned>(submitted);
+            _inFlight += static_cast<size_t>(submitted);
+
+            reap([&] (const io_uring_cqe& cqe) {
+                auto slot = static_cast<unsigned>(cqe.user_data);
+                auto& status = out[_slotPath[slot]];
+                status.found = cqe.res == 0;
+                if (status.found) {
+                    status.mode = _buffers[slot].stx_mode;
+                    status.uid = _buffers[slot].stx_uid;
+                    status.gid = _buffers[slot].stx_gid;
+                }
+                freeSlots.push_back(slot);
+                done++;
+            });
+        }
+        return true;
+    }
+
+    // Submits requests and waits for at least one completion.
+    long enter(unsigned submit)
+    {
+        return syscall(
+            __NR_io_uring_enter, _fd, submit, 1, IORING_ENTER_GETEVENTS,
+            nullptr, 0);
+    }
+
+private:
+    template <class F>
+    void reap(F completed)
+    {
+        auto head = *_cqHead;
+        auto end = __atomic_load_n(_cqTail, __ATOMIC_ACQUIRE);
+        for (; head != end; head++) {
+            completed(_cqes[head & _cqMask]);
+            _inFlight--;
+        }
+        __atomic_store_n(_cqHead, head, __ATOMIC_RELEASE);
+    }
+
+    // Waits for the requests in flight. If even that fails, the buffers are
+    // leaked rather than freed under the kernel.
+    void drain()
+    {
+        for (;;) {
+            reap([] (const io_uring_cqe&) { });
+            if (_inFlight == 0) {
+                return;
+            }
+            auto waited = syscall(
+                __NR_io_uring_enter, _fd, 0, 1, IORING_ENTER_GETEVENTS,
+                nullptr, 0);
+            if (waited < 0 && errno != EINTR) {
+                (void)_buffers.release();
+                _ready = false;
+                return;
+            }
+        }
+    }
+
+    bool supportsStatx() const
+    {
+        const unsigned ops = 256;
+        auto size = sizeof(io_uring_probe) + ops * sizeof(io_uring_probe_op);
+        auto buffer = std::unique_ptr<std::uint64_t[]>{
+            new std::uint64_t[(size + 7) / 8]()};
+        auto probe = reinterpret_cast<io_uring_probe*>(buffer.get());
+        if (syscall(__NR_io_uring_register, _fd, IORING_REGISTER_PROBE,
+                probe, ops) < 0) {
+            return false;
+        }
+        return probe->last_op >= IORING_OP_STATX &&
+            (probe->ops[IORING_OP_STATX].flags & IO_URING_OP_SUPPORTED);
+    }
+
+    void* map(size_t size, off_t offset) const
+    {
+        auto p = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+            MAP_SHARED | MAP_POPULATE, _fd, offset);
+        return p != MAP_FAILED ? p : nullptr;
+    }
+
+    int _fd = -1;
+    bool _ready = false;
+    unsigned _entries = 0;
+    void* _sq = nullptr;
+    void* _cq = nullptr;
+    size_t _sqSize = 0;
+    size_t _cqSize = 0;
+    size_t _sqesSize = 0;
+    io_uring_sqe* _sqes = nullptr;
+    unsigned* _sqTail = nullptr;
+    unsigned* _sqArray = nullptr;
+    unsigned _sqMask = 0;
+    unsigned* _cqHead = nullptr;
+    unsigned* _cqTail = nullptr;
+    io_uring_cqe* _cqes = nullptr;
+    unsigned _cqMask = 0;
+    size_t _inFlight = 0;
+    std::unique_ptr<struct statx[]> _buffers;
+    std::vector<size_t> _slotPath;
+};
+#endif
+
+inline void statPathsOnThreads(
+    const char* const* names, size_t n, FileStatus* out)
+{
+    auto threads = std::min<size_t>(ioThreads(), n / 64 + 1);
+    auto chunk = [&] (size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            struct stat info;
+            out[i].found = ::stat(names[i], &info) == 0;
+            if (out[i].found) {
+                out[i].mode = static_cast<std::uint32_t>(info.st_mode);
+                out[i].uid = static_cast<std::uint32_t>(info.st_uid);
+                out[i].gid = static_cast<std::uint32_t>(info.st_gid);
+            }
+        }
+    };
+    parallelFor(n, static_cast<unsigned>(threads), chunk);
+}
+
+// Below this many paths, setting up a ring costs more than looking them up
+// one after the other.
+const size_t minRingBatch = 32;
+
+// Looks up all the paths in one batch: as asynchronous statx calls on an
+// io_uring where the system has one, on threads otherwise. Small batches,
+// such as the value of a tracked edit, are looked up on this thread.
+inline void statPaths(const char* const* names, size_t n, FileStatus* out)
+{
+#if defined(AA_HAS_IO_URING)
+    if (n >= minRingBatch) {
+        // The kernel rounds the size up to a power of two.
+        StatRing ring{static_cast<unsigned>(std::min<size_t>(n, 256))};
+        if (ring.ready() && ring.run(names, n, out)) {
+            return;
+        }
+    }
+#endif
+    statPathsOnThreads(names, n, out);
+}
+
+// Whether this process may read what a path names, judging from its
+// permission bits like access() does for the effective user. ACLs are not
+// taken into account.
+class Reader {
+public:
+    Reader()
+    {
+#if !defined(_WIN32)
+        _uid = ::geteuid();
+        _groups.push_back(::getegid());
+        auto count = ::getgroups(0, nullptr);
+        if (count > 0) {
+            auto groups = std::vector<gid_t>(static_cast<size_t>(count));
+            count = ::getgroups(count, groups.data());
+            for (int i = 0; i < count; i++) {
+                _groups.push_back(groups[static_cast<size_t>(i)]);
+            }
+        }
+#endif
+    }
+
+    bool canRead(const FileStatus& status) const
+    {
+#if defined(_WIN32)
+        return (status.mode & _S_IREAD) != 0;
+#else
+        if (_uid == 0) {
+            return true;
+        }
+        if (status.uid == _uid) {
+            return (status.mode & S_IRUSR) != 0;
+        }
+        if (std::find(_groups.begin(), _groups.end(), status.gid) !=
+                _groups.end()) {
+            return (status.mode & S_IRGRP) != 0;
+        }
+        return (status.mode & S_IROTH) != 0;
+#endif
+    }
+
+private:
+#if !defined(_WIN32)
+    std::uint32_t _uid = 0;
+    std::vector<std::uint32_t> _groups;
+#endif
+};
+
+}} // namespace aa::internal
@@ -0,0 +1,265 @@
+#pragma once
+
+#include "error.hpp"
+#include "internal.hpp"
+#include "options.hpp"
+
+#include <cstddef>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#if defined(__cpp_constinit)
+#define AA_CONSTINIT constinit
+#else
+#define AA_CONSTINIT
+#endif
+
+namespace aa {
+
+namespace internal {
+
+// Fields shared by static options and flags. Everything is a literal, so
+// declarations are constant-initialized and need no destructor.
+struct StaticData {
+    static const size_t maxNames = 4;
+
+    struct Names {
+        const char* at[maxNames];
+    };
+
+    std::vector<std::string> flags() const
+    {
+        auto result = std::vector<std::string>{};
+        for (auto name : names.at) {
+            if (name) {
+                result.emplace_back(name);
+            }
+        }
+        return result;
+    }
+
+    Names names;
+    const char* metavar;
+    const char* help;
+    const char* env;
+    const char* init;
+    bool required;
+};
+
+// Where static options and flags point at the data a parser made for them.
+// The parser clears them when it goes away, so that they read as undeclared
+// rather than dangle, and can be declared to another parser.
+class StaticLinks {
+public:
+    StaticLinks() = default;
+
+    StaticLinks(StaticLinks&& other) noexcept
+        : _links(std::move(other._links))
+    {
+        other._links.clear();
+    }
+
+    StaticLinks& operator=(StaticLinks&& other) noexcept
+    {
+        if (this != &other) {
+            clear();
+            _links = std::move(other._links);
+            other._links.clear();
+        }
+        return *this;
+    }
+
+    ~StaticLinks()
+    {
+        clear();
+    }
+
+    void add(OptionInfo** link)
+    {
+        _links.push_back(link);
+    }
+
+private:
+    void clear()
+    {
+        for (auto link : _links) {
+            *link = nullptr;
+        }
+        _links.clear();
+    }
+
+    std::vector<OptionInfo**> _links;
+};
+
+} // namespace internal
+
+// An option that can be declared at namespace scope without running any code
+// before main():
+//
+//     AA_CONSTINIT aa::StaticOption<int> port =
+//         aa::StaticOption<int>{"-p", "--port"}.init("8080");
+//
+// It is registered when passed to Parser::declare() or aa::parse(), and must
+// not be read before that or after that parser is gone. It can be declared to
+// one parser at a time. Defaults given to init() are converted like
+// command line values.
+template <class T>
+class StaticOption final {
+public:
+    template <
+        class... Names,
+        class = typename std::enable_if<
+            internal::conjunction<
+                std::is_convertible<Names, const char*>...>::value>::type>
+    constexpr explicit StaticOption(const Names&... names)
+        : StaticOption{
+            internal::StaticData{{{names...}}, nullptr, nullptr, nullptr,
+                nullptr, false},
+            nullptr}
+    {
+        static_assert(
+            sizeof...(Names) <= internal::StaticData::maxNames,
+            "too many names for a static option");
+    }
+
+    constexpr StaticOption metavar(const char* name) const
+    {
+        return StaticOption{
+            internal::StaticData{_static.names, name, _static.help,
+                _static.env, _static.init, _static.required},
+            nullptr};
+    }
+
+    constexpr StaticOption required() const
+    {
+        return StaticOption{
+            internal::StaticData{_static.names, _static.metavar, _static.help,
+                _static.env, _static.init, true},
+            nullptr};
+    }
+
+    constexpr StaticOption help(const char* message) const
+    {
+        return StaticOption{
+            internal::StaticData{_static.names, _static.metavar, message,
+                _static.env, _static.init, _static.required},
+            nullptr};
+    }
+
+    constexpr StaticOption env(const char* name) const
+    {
+        return StaticOption{
+            internal::StaticData{_static.names, _static.metavar, _static.help,
+                name, _static.init, _static.required},
+            nullptr};
+    }
+
+    constexpr StaticOption init(const char* value) const
+    {
+        return StaticOption{
+            internal::StaticData{_static.names, _static.metavar, _static.help,
+                _static.env, value, _static.required},
+            nullptr};
+    }
+
+    const Values<T>& all() const
+    {
+        if (!_data) {
+            FAIL("reading option " +
+                internal::join(_static.flags(), ",") +
+                " before it is declared to a parser");
+        }
+        return *static_cast<const TypedOptionData<T>*>(_data)->current.load(
+            std::memory_order_acquire);
+    }
+
+    const T& operator*() const
+    {
+        if (all().empty()) {
+            FAIL("attempting to access empty option " +
+                internal::join(_static.flags(), ","));
+        }
+        return all().back();
+    }
+
+    operator const T&() const
+    {
+        return **this;
+    }
+
+    const T* operator->() const
+    {
+        return &**this;
+    }
+
+private:
+    friend class Parser;
+
+    constexpr StaticOption(internal::StaticData data, OptionInfo* typed)
+        : _static(data)
+        , _data(typed)
+    { }
+
+    internal::StaticData _static;
+    // A TypedOptionData<T>, kept as OptionInfo so that the parser can clear
+    // it along with those of flags.
+    OptionInfo* _data;
+};
+
+// A flag that can be declared at namespace scope without running any code
+// before main(). Reads as 0 until it is declared to a parser.
+class StaticFlag final {
+public:
+    template <
+        class... Names,
+        class = typename std::enable_if<
+            internal::conjunction<
+                std::is_convertible<Names, const char*>...>::value>::type>
+    constexpr explicit StaticFlag(const Names&... names)
+        : StaticFlag{
+            internal::StaticData{{{names...}}, nullptr, nullptr, nullptr,
+                nullptr, false},
+            nullptr}
+    {
+        static_assert(
+            sizeof...(Names) <= internal::StaticData::maxNames,
+            "too many names for a static flag");
+    }
+
+    constexpr StaticFlag help(const char* message) const
+    {
+        return StaticFlag{
+            internal::StaticData{_static.names, nullptr, message, nullptr,
+                nullptr, false},
+            nullptr};
+    }
+
+    int operator*() const
+    {
+        return _data ? _data->count : 0;
+    }
+
+    explicit operator bool() const
+    {
+        return **this > 0;
+    }
+
+    operator int() const
+    {
+        return **this;
+    }
+
+private:
+    friend class Parser;
+
+    constexpr StaticFlag(internal::StaticData data, OptionInfo* flag)
+        : _static(data)
+        , _data(flag)
+    { }
+
+    internal::StaticData _static;
+    OptionInfo* _data;
+};
+
+} // namespace aa
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace aa {
+
+// Parsing counters, collected when the library is compiled with AA_STATS
+// defined. Counting costs an increment per event; the clock is read twice per
+// parse, and once per sampled conversion.
+struct Stats {
+    // One conversion in this many is timed, per option.
+    static const std::uint64_t conversionSampleRate = 64;
+
+    struct Conversions {
+        std::string type;
+        std::uint64_t count = 0;
+        // Estimated from the sampled conversions.
+        std::chrono::nanoseconds time{0};
+    };
+
+    bool enabled = false;
+    std::uint64_t tokens = 0;
+    std::uint64_t longOptions = 0;
+    std::uint64_t shortOptions = 0;
+    std::uint64_t bundledOptions = 0;
+    std::uint64_t positionals = 0;
+    std::uint64_t allocations = 0;
+    std::uint64_t errors = 0;
+    std::chrono::nanoseconds parseTime{0};
+    std::vector<Conversions> conversions;
+
+    void print(std::ostream& out) const
+    {
+        out << "tokens " << tokens << "\n" <<
+            "long_options " << longOptions << "\n" <<
+            "short_options " << shortOptions << "\n" <<
+            "bundled_options " << bundledOptions << "\n" <<
+            "positionals " << positionals << "\n" <<
+            "allocations " << allocations << "\n" <<
+            "errors " << errors << "\n" <<
+            "parse_time_ns " << parseTime.count() << "\n";
+        for (const auto& conversion : conversions) {
+            out << "conversions{type=" << conversion.type << "} " <<
+                conversion.count << "\n" <<
+                "conversion_time_ns{type=" << conversion.type << "} " <<
+                conversion.time.count() << "\n";
+        }
+    }
+};
+
+#if defined(AA_STATS)
+#define AA_STAT(EXPRESSION) \
+    do {                    \
+        EXPRESSION;         \
+    } while (false)
+#else
+#define AA_STAT(EXPRESSION) \
+    do {                    \
+    } while (false)
+#endif
+
+} // namespace aa
@@ -0,0 +1,375 @@
+#pragma once
+
+#include "convert.hpp"
+
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <system_error>
+#include <type_traits>
+#include <vector>
+
+namespace aa {
+
+// A size in bytes. Values take an optional decimal (k, M, G, T, P, E) or
+// binary (Ki, Mi, ..., Ei) multiplier and an optional B: 4096, 64k, 4GiB,
+// 1.5MB.
+struct bytes {
+    std::uint64_t count = 0;
+
+    operator std::uint64_t() const
+    {
+        return count;
+    }
+};
+
+// Durations are std::chrono durations, so any of them can be an option type.
+// Values are one or more numbers with units ns, us, ms, s, m, h or d: 250ms,
+// 1.5s, 1h30m.
+using duration = std::chrono::nanoseconds;
+
+// Events per second. Values take an optional decimal multiplier and an
+// optional time unit: 10k/s, 500/ms, 3M/h.
+struct rate {
+    double perSecond = 0;
+
+    operator double() const
+    {
+        return perSecond;
+    }
+};
+
+// A file system path. Any value but an empty one is accepted; see
+// Option::exists() and Option::readable() for checking what it names.
+struct path {
+    std::string name;
+
+    operator const std::string&() const
+    {
+        return name;
+    }
+};
+
+namespace internal {
+
+// Whether values of an option type name files, so that glob patterns among
+// them are expanded.
+template <class T>
+struct NamesFiles : std::false_type { };
+
+template <>
+struct NamesFiles<path> : std::true_type { };
+
+template <>
+struct NamesFiles<std::vector<path>> : std::true_type { };
+
+// Reads an unsigned decimal number with an optional fraction. Returns the end
+// of the number, or nullptr if there is none or it does not fit.
+inline const char* scanNumber(
+    const char* p,
+    const char* end,
+    std::uint64_t& whole,
+    double& value,
+    bool& fractional)
+{
+    if (p == end || *p < '0' || *p > '9') {
+        return nullptr;
+    }
+#if defined(__cpp_lib_to_chars)
+    auto integer = std::from_chars(p, end, whole);
+    if (integer.ec != std::errc{}) {
+        return nullptr;
+    }
+    const char* q = integer.ptr;
+#else
+    char* q = nullptr;
+    errno = 0;
+    whole = std::strtoull(p, &q, 10);
+    if (errno == ERANGE) {
+        return nullptr;
+    }
+#endif
+    fractional = q != end && *q == '.';
+    if (!fractional) {
+        value = static_cast<double>(whole);
+        return q;
+    }
+#if defined(__cpp_lib_to_chars)
+    auto real = std::from_chars(p, end, value, std::chars_format::fixed);
+    return real.ec == std::errc{} ? real.ptr : nullptr;
+#else
+    char* r = nullptr;
+    value = std::strtod(p, &r);
+    return r;
+#endif
+}
+
+// Scales a number by a unit, rejecting results that do not fit below max.
+inline bool scale(
+    std::uint64_t whole,
+    double value,
+    bool fractional,
+    std::uint64_t unit,
+    std::uint64_t max,
+    std::uint64_t& result)
+{
+    if (!fractional) {
+        if (whole != 0 && unit > max / whole) {
+            return false;
+        }
+        result = whole * unit;
+        return true;
+    }
+    auto scaled = value * static_cast<double>(unit) + 0.5;
+    if (!(scaled < static_cast<double>(max))) {
+        return false;
+    }
+    result = static_cast<std::uint64_t>(scaled);
+    return true;
+}
+
+// Decimal multipliers, by their one-letter prefixes, as powers of 1000.
+inline int multiplierPower(char prefix)
+{
+    static const char prefixes[] = "kMGTPE";
+    if (prefix == 'K') {
+        prefix = 'k';
+    }
+    auto found = std::strchr(prefixes, prefix);
+    return prefix != '\0' && found ? static_cast<int>(found - prefixes) + 1 : 0;
+}
+
+struct TimeUnit {
+    const char* name;
+    size_t size;
+    std::uint64_t nanoseconds;
+};
+
+const size_t timeUnitCount = 9;
+
+// Longer names come first where they share a prefix.
+inline const TimeUnit* timeUnits()
+{
+    static const TimeUnit units[timeUnitCount] = {
+        {"ns", 2, 1},
+        {"us", 2, 1000},
+        {"\xc2\xb5s", 3, 1000},
+        {"ms", 2, 1000000},
+        {"min", 3, 60000000000},
+        {"s", 1, 1000000000},
+        {"m", 1, 60000000000},
+        {"h", 1, 3600000000000},
+        {"d", 1, 86400000000000},
+    };
+    return units;
+}
+
+inline const TimeUnit* scanTimeUnit(const char* p, const char* end)
+{
+    for (size_t i = 0; i < timeUnitCount; i++) {
+        const auto& unit = timeUnits()[i];
+        if (static_cast<size_t>(end - p) >= unit.size &&
+                std::memcmp(p, unit.name, unit.size) == 0) {
+            return &unit;
+        }
+    }
+    return nullptr;
+}
+
+inline bool parseBytes(const char* p, const char* end, std::uint64_t& count)
+{
+    auto whole = std::uint64_t{};
+    auto value = 0.0;
+    auto fractional = false;
+    p = scanNumber(p, end, whole, value, fractional);
+    if (p == nullptr) {
+        return false;
+    }
+
+    auto unit = std::uint64_t{1};
+    if (p != end) {
+        if (int power = multiplierPower(*p)) {
+            ++p;
+            bool binary = p != end && *p == 'i';
+            if (binary) {
+                ++p;
+            }
+            for (int i = 0; i < power; i++) {
+                unit *= binary ? 1024 : 1000;
+            }
+        }
+    }
+    if (p != end && *p == 'B') {
+        ++p;
+    }
+    return p == end && scale(
+        whole, value, fractional, unit,
+        std::numeric_limits<std::uint64_t>::max(), count);
+}
+
+// Parses a sum of numbers with units into nanoseconds.
+inline bool parseDuration(const char* p, const char* end, std::int64_t& result)
+{
+    bool negative = p != end && *p == '-';
+    if (negative) {
+        ++p;
+    }
+    if (end - p == 1 && *p == '0') {
+        result = 0;
+        return true;
+    }
+
+    const auto max = static_cast<std::uint64_t>(
+        std::numeric_limits<std::int64_t>::max());
+    auto total = std::uint64_t{0};
+    do {
+        auto whole = std::uint64_t{};
+        auto value = 0.0;
+        auto fractional = false;
+        p = scanNumber(p, end, whole, value, fractional);
+        if (p == nullptr) {
+            return false;
+        }
+        auto unit = scanTimeUnit(p, end);
+        if (unit == nullptr) {
+            return false;
+        }
+        p += unit->size;
+
+        auto part = std::uint64_t{};
+        if (!scale(whole, value, fractional, unit->nanoseconds, max, part) ||
+                part > max - total) {
+            return false;
+        }
+        total += part;
+    } while (p != end);
+
+    result = negative ?
+        -static_cast<std::int64_t>(total) : static_cast<std::int64_t>(total);
+    return true;
+}
+
+inline bool parseRate(const char* p, const char* end, double& perSecond)
+{
+    auto whole = std::uint64_t{};
+    auto value = 0.0;
+    auto fractional = false;
+    p = scanNumber(p, end, whole, value, fractional);
+    if (p == nullptr) {
+        return false;
+    }
+
+    if (p != end) {
+        if (int power = multiplierPower(*p)) {
+            ++p;
+            value *= std::pow(1000.0, power);
+        }
+    }
+    if (p != end && *p == '/') {
+        auto unit = scanTimeUnit(p + 1, end);
+        if (unit == nullptr || p + 1 + unit->size != end) {
+            return false;
+        }
+        p = end;
+        value *= 1e9 / static_cast<double>(unit->nanoseconds);
+    }
+    perSecond = value;
+    return p == end && std::isfinite(value);
+}
+
+template <>
+struct Converter<bytes> {
+    static bool convert(const char* data, size_t size, bytes& value)
+    {
+        return parseBytes(data, data + size, value.count);
+    }
+};
+
+template <>
+struct Converter<rate> {
+    static bool convert(const char* data, size_t size, rate& value)
+    {
+        return parseRate(data, data + size, value.perSecond);
+    }
+};
+
+template <>
+struct Converter<path> {
+    static bool convert(const char* data, size_t size, path& value)
+    {
+        value.name.assign(data, size);
+        return size > 0;
+    }
+};
+
+// Values that are not a whole number of the duration's period, or are out of
+// its range, are rejected rather than rounded.
+template <class Rep, class Period>
+struct Converter<std::chrono::duration<Rep, Period>> {
+    using Duration = std::chrono::duration<Rep, Period>;
+
+    static bool convert(const char* data, size_t size, Duration& value)
+    {
+        auto count = std::int64_t{};
+        if (!parseDuration(data, data + size, count)) {
+            return false;
+        }
+        auto ns = std::chrono::nanoseconds{count};
+        value = std::chrono::duration_cast<Duration>(ns);
+        return std::is_floating_point<Rep>::value ||
+            std::chrono::duration_cast<std::chrono::nanoseconds>(value) == ns;
+    }
+};
+
+inline size_t formatValue(bytes value, char* out)
+{
+    return formatValue(value.count, out);
+}
+
+inline size_t formatValue(const path& value, char* out)
+{
+    return formatValue(value.name, out);
+}
+
+inline size_t formatValue(rate value, char* out)
+{
+    auto size = formatValue(value.perSecond, out);
+    if (out != nullptr) {
+        std::memcpy(out + size, "/s", 2);
+    }
+    return size + 2;
+}
+
+// Renders durations in the largest unit that keeps them exact.
+template <class Rep, class Period>
+size_t formatValue(std::chrono::duration<Rep, Period> value, char* out)
+{
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        value).count();
+    if (ns == 0) {
+        return formatValue('0', out);
+    }
+    const TimeUnit* unit = &timeUnits()[0];
+    for (size_t i = 1; i < timeUnitCount; i++) {
+        const auto& candidate = timeUnits()[i];
+        auto n = static_cast<std::int64_t>(candidate.nanoseconds);
+        if (ns % n == 0 && candidate.nanoseconds > unit->nanoseconds) {
+            unit = &candidate;
+        }
+    }
+    auto size = formatValue(
+        ns / static_cast<std::int64_t>(unit->nanoseconds), out);
+    if (out != nullptr) {
+        std::memcpy(out + size, unit->name, unit->size);
+    }
+    return size + unit->size;
+}
+
+} // namespace internal
+
+} // namespace aa
@@ -0,0 +1,266 @@
+#pragma once
+
+#include "convert.hpp"
+#include "options.hpp"
+#include "parallel.hpp"
+#include "snapshot.hpp"
+#include "stats.hpp"
+#include "units.hpp"
+
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#if defined(AA_STATS)
+#include <chrono>
+#endif
+
+namespace aa {
+
+inline bool OptionData::supply(std::string value, Source from)
+{
+    if (from < source) {
+        return true;
+    }
+    if (from > source) {
+        clearValues();
+        arguments.clear();
+        source = from;
+    }
+#if defined(AA_STATS)
+    if (conversions++ % Stats::conversionSampleRate == 0) {
+        auto start = std::chrono::steady_clock::now();
+        bool accepted = parseValue(std::move(value));
+        sampledTime += std::chrono::steady_clock::now() - start;
+        return accepted;
+    }
+#endif
+    return parseValue(std::move(value));
+}
+
+template <class T>
+bool TypedOptionData<T>::parseValue(std::string s)
+{
+#if defined(AA_STATS)
+    auto capacity = values.capacity();
+#endif
+    auto value = T{};
+    if (!convert(s, value)) {
+        return false;
+    }
+    if (keepLast && !values.empty()) {
+        values.back() = std::move(value);
+    } else {
+        values.push_back(std::move(value));
+    }
+    AA_STAT(allocations += values.capacity() != capacity);
+    return true;
+}
+
+// Values are converted straight into their slots, each thread filling its
+// own range, and rejected ones are squeezed out afterwards.
+template <class T>
+void TypedOptionData<T>::parseValues(
+    const std::vector<View>& raw,
+    unsigned threads,
+    std::vector<size_t>& rejected)
+{
+#if defined(AA_STATS)
+    auto start = std::chrono::steady_clock::now();
+#endif
+    auto base = values.size();
+    values.resize(base + raw.size());
+    auto accepted = std::unique_ptr<bool[]>{new bool[raw.size()]};
+    auto chunk = [&] (size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            accepted[i] = convert(raw[i].data, raw[i].size, values[base + i]);
+        }
+    };
+    internal::parallelFor(raw.size(), threads, chunk);
+
+    auto out = base;
+    for (size_t i = 0; i < raw.size(); i++) {
+        if (!accepted[i]) {
+            rejected.push_back(i);
+            continue;
+        }
+        if (out != base + i) {
+            values[out] = std::move(values[base + i]);
+        }
+        out++;
+    }
+    values.resize(out);
+#if defined(AA_STATS)
+    // Counted as if every conversion had been sampled at the usual rate.
+    conversions += raw.size();
+    sampledTime += (std::chrono::steady_clock::now() - start) *
+        ((raw.size() + Stats::conversionSampleRate - 1) /
+            Stats::conversionSampleRate) / raw.size();
+#endif
+}
+
+template <class T>
+bool TypedOptionData<T>::accepts(const std::string& s) const
+{
+    auto value = T{};
+    return convert(s, value);
+}
+
+template <class T>
+bool TypedOptionData<T>::convert(const std::string& s, T& value) const
+{
+    return convert(s.data(), s.size(), value);
+}
+
+template <class T>
+bool TypedOptionData<T>::convert(
+    const char* data, size_t size, T& value) const
+{
+    if (choiceTable.empty()) {
+        return internal::Converter<T>::convert(data, size, value);
+    }
+    auto found = choiceTable.find(data, size);
+    if (found == nullptr) {
+        return false;
+    }
+    value = *found;
+    return true;
+}
+
+template <class T>
+void TypedOptionData<T>::clearValues()
+{
+    values.clear();
+}
+
+// Converts a new set of values and swaps it in for readers, without touching
+// the values they may be reading right now, or ever freeing them while this
+// lives. Calls are serialized by the caller.
+template <class T>
+void TypedOptionData<T>::publish(const std::vector<std::string>& raw)
+{
+    // A file saved once can be reported as changed several times.
+    if (published.load() && raw == publishedRaw) {
+        return;
+    }
+    publishedRaw = raw;
+    auto snapshot = std::make_shared<Values<T>>();
+    snapshot->reserve(keepLast ? 1 : raw.size());
+    for (const auto& s : raw) {
+        auto value = T{};
+        if (!convert(s, value)) {
+            continue;
+        }
+        if (keepLast && !snapshot->empty()) {
+            snapshot->back() = std::move(value);
+        } else {
+            snapshot->push_back(std::move(value));
+        }
+    }
+    retired.push_back(snapshot);
+    published.store(snapshot);
+    current.store(snapshot.get(), std::memory_order_release);
+}
+
+template <class T>
+void TypedOptionData<T>::typeTag(std::string& out) const
+{
+    internal::Codec<T>::tag(out);
+}
+
+template <class T>
+void TypedOptionData<T>::saveValues(std::string& out) const
+{
+    internal::Codec<T>::save(out, values);
+}
+
+template <class T>
+const char* TypedOptionData<T>::loadValues(const char* p, const char* end)
+{
+    return internal::Codec<T>::load(p, end, values);
+}
+
+template <class T>
+size_t TypedOptionData<T>::valueCount() const
+{
+    return current.load(std::memory_order_acquire)->size();
+}
+
+template <class T>
+size_t TypedOptionData<T>::formatValue(size_t i, char* out) const
+{
+    const auto& value = (*current.load(std::memory_order_acquire))[i];
+    if (!choiceTable.empty()) {
+        if (auto name = internal::choiceName(choiceTable, value, 0)) {
+            return internal::formatValue(*name, out);
+        }
+    }
+    return internal::formatValue(value, out);
+}
+
+template <class T>
+std::shared_ptr<void> TypedOptionData<T>::convertValue(
+    const char* data, size_t size) const
+{
+    auto value = std::make_shared<T>();
+    if (!convert(data, size, *value)) {
+        return nullptr;
+    }
+    return value;
+}
+
+template <class T>
+void TypedOptionData<T>::insertValue(size_t at, const void* value)
+{
+    values.insert(values.begin() + at, *static_cast<const T*>(value));
+}
+
+template <class T>
+void TypedOptionData<T>::eraseValue(size_t at)
+{
+    values.erase(values.begin() + at);
+}
+
+template <class T>
+std::unique_ptr<OptionData> TypedOptionData<T>::cloneValues() const
+{
+    auto clone = std::unique_ptr<OptionData>{new TypedOptionData<T>};
+    static_cast<TypedOptionData<T>&>(*clone).values = values;
+    return clone;
+}
+
+template <class T>
+void TypedOptionData<T>::assignValues(const OptionData& other)
+{
+    values = static_cast<const TypedOptionData<T>&>(other).values;
+}
+
+template <class T>
+void TypedOptionData<T>::checkValues(
+    size_t begin, size_t end, std::vector<internal::Failure>& failures) const
+{
+    auto failed = std::vector<size_t>{};
+    for (const auto& check : checks) {
+        failed.clear();
+        check.run(values.data() + begin, end - begin, failed);
+        for (auto i : failed) {
+            failures.push_back(internal::Failure{begin + i, &check.expected});
+        }
+    }
+}
+
+#if defined(AA_COMPILED)
+// Instantiated once, in the aa_compiled library.
+extern template struct TypedOptionData<int>;
+extern template struct TypedOptionData<long>;
+extern template struct TypedOptionData<long long>;
+extern template struct TypedOptionData<unsigned>;
+extern template struct TypedOptionData<unsigned long>;
+extern template struct TypedOptionData<unsigned long long>;
+extern template struct TypedOptionData<float>;
+extern template struct TypedOptionData<double>;
+extern template struct TypedOptionData<std::string>;
+#endif
+
+} // namespace aa
@@ -0,0 +1,146 @@
+#pragma once
+
+#include "error.hpp"
+
+#include <functional>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#if defined(__linux__)
+#include <cerrno>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace aa {
+namespace internal {
+
+// Calls a function from a background thread whenever one of the given files
+// is written or replaced. The containing directories are watched rather than
+// the files themselves, so that editors which save through a rename are
+// noticed as well.
+class FileWatcher {
+public:
+    FileWatcher(
+        const std::vector<std::string>& paths, std::function<void()> changed)
+        : _changed(std::move(changed))
+    {
+#if defined(__linux__)
+        _inotify = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (_inotify < 0 || ::pipe2(_stop, O_CLOEXEC) != 0) {
+            closeAll();
+            FAIL("failed to set up file watching");
+        }
+
+        for (const auto& path : paths) {
+            auto slash = path.find_last_of('/');
+            auto directory = slash == std::string::npos ? std::string{"."} :
+                slash == 0 ? std::string{"/"} : path.substr(0, slash);
+            auto name = slash == std::string::npos ?
+                path : path.substr(slash + 1);
+
+            int descriptor = ::inotify_add_watch(
+                _inotify, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+            if (descriptor >= 0) {
+                _watches.push_back(Watch{descriptor, std::move(name)});
+            }
+        }
+
+        _thread = std::thread{&FileWatcher::run, this};
+#else
+        (void)paths;
+        FAIL("watching files is not supported on this platform");
+#endif
+    }
+
+    FileWatcher(const FileWatcher&) = delete;
+    FileWatcher& operator=(const FileWatcher&) = delete;
+
+    ~FileWatcher()
+    {
+#if defined(__linux__)
+        if (_thread.joinable()) {
+            char byte = 0;
+            while (::write(_stop[1], &byte, 1) < 0 && errno == EINTR) {
+            }
+            _thread.join();
+        }
+        closeAll();
+#endif
+    }
+
+private:
+#if defined(__linux__)
+    struct Watch {
+        int descriptor;
+        std::string name;
+    };
+
+    void run()
+    {
+        alignas(inotify_event) char buffer[4096];
+
+        for (;;) {
+            pollfd fds[2] = {{_inotify, POLLIN, 0}, {_stop[0], POLLIN, 0}};
+            if (::poll(fds, 2, -1) < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                return;
+            }
+            if (fds[1].revents != 0) {
+                return;
+            }
+
+            bool changed = false;
+            ssize_t size;
+            while ((size = ::read(_inotify, buffer, sizeof(buffer))) > 0) {
+                for (const char* p = buffer; p < buffer + size; ) {
+                    auto event = reinterpret_cast<const inotify_event*>(p);
+                    changed = changed || matches(*event);
+                    p += sizeof(inotify_event) + event->len;
+                }
+            }
+
+            if (changed) {
+                _changed();
+            }
+        }
+    }
+
+    bool matches(const inotify_event& event) const
+    {
+        if (event.len == 0) {
+            return false;
+        }
+        for (const auto& watch : _watches) {
+            if (watch.descriptor == event.wd && watch.name == event.name) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void closeAll()
+    {
+        for (int fd : {_inotify, _stop[0], _stop[1]}) {
+            if (fd >= 0) {
+                ::close(fd);
+            }
+        }
+        _inotify = _stop[0] = _stop[1] = -1;
+    }
+
+    int _inotify = -1;
+    int _stop[2] = {-1, -1};
+    std::vector<Watch> _watches;
+#endif
+    std::function<void()> _changed;
+    std::thread _thread;
+};
+
+}} // namespace aa::internal
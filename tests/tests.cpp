@@ -1,11 +1,31 @@
 #include <aa.hpp>
+#include <aa/stat.hpp>
 
 #define CATCH_CONFIG_MAIN
 #include <catch.hpp>
 
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
 #include <string>
+#include <thread>
+#include <type_traits>
 #include <vector>
 
+#if defined(_WIN32)
+#include <direct.h>
+#include <io.h>
+#else
+#include <dirent.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 std::vector<char*> toArgv(std::vector<std::string>& args)
 {
     std::vector<char*> results;
@@ -15,6 +35,121 @@ std::vector<char*> toArgv(std::vector<std::string>& args)
     return results;
 }
 
+void setEnv(const char* name, const char* value)
+{
+#if defined(_WIN32)
+    _putenv_s(name, value);
+#else
+    setenv(name, value, 1);
+#endif
+}
+
+// A directory of a test's own, under TEST_TMPDIR when the test runner sets
+// it, removed with everything in it when the test ends, passed or not.
+class TempDir {
+public:
+    TempDir()
+    {
+        const char* base = std::getenv("TEST_TMPDIR");
+#if defined(_WIN32)
+        if (base == nullptr) {
+            base = std::getenv("TEMP");
+        }
+        _path = std::string{base != nullptr ? base : "."} + "/aa_test_XXXXXX";
+        if (_mktemp_s(&_path[0], _path.size() + 1) != 0 ||
+                _mkdir(_path.c_str()) != 0) {
+            throw std::runtime_error{"cannot create " + _path};
+        }
+#else
+        if (base == nullptr) {
+            base = std::getenv("TMPDIR");
+        }
+        _path = std::string{base != nullptr ? base : "/tmp"} +
+            "/aa_test_XXXXXX";
+        if (mkdtemp(&_path[0]) == nullptr) {
+            throw std::runtime_error{"cannot create " + _path};
+        }
+#endif
+    }
+
+    TempDir(const TempDir&) = delete;
+    TempDir& operator=(const TempDir&) = delete;
+
+    ~TempDir()
+    {
+        removeAll(_path);
+    }
+
+    // The path of a file or directory in it.
+    std::string path(const std::string& name) const
+    {
+        return _path + "/" + name;
+    }
+
+private:
+    static void removeAll(const std::string& path)
+    {
+#if defined(_WIN32)
+        auto entry = _finddata_t{};
+        auto handle = _findfirst((path + "/*").c_str(), &entry);
+        if (handle != -1) {
+            do {
+                auto name = std::string{entry.name};
+                if (name == "." || name == "..") {
+                    continue;
+                }
+                if (entry.attrib & _A_SUBDIR) {
+                    removeAll(path + "/" + name);
+                } else {
+                    std::remove((path + "/" + name).c_str());
+                }
+            } while (_findnext(handle, &entry) == 0);
+            _findclose(handle);
+        }
+        _rmdir(path.c_str());
+#else
+        if (auto dir = opendir(path.c_str())) {
+            while (auto entry = readdir(dir)) {
+                auto name = std::string{entry->d_name};
+                if (name == "." || name == "..") {
+                    continue;
+                }
+                auto child = path + "/" + name;
+                struct stat info;
+                if (lstat(child.c_str(), &info) == 0 && S_ISDIR(info.st_mode)) {
+                    removeAll(child);
+                } else {
+                    std::remove(child.c_str());
+                }
+            }
+            closedir(dir);
+        }
+        rmdir(path.c_str());
+#endif
+    }
+
+    std::string _path;
+};
+
+// Counts how often values are converted.
+struct Counted {
+    int value = 0;
+    static int conversions;
+};
+
+int Counted::conversions = 0;
+
+std::istream& operator>>(std::istream& in, Counted& counted)
+{
+    Counted::conversions++;
+    return in >> counted.value;
+}
+
+std::ostream& operator<<(std::ostream& out, const Counted& counted)
+{
+    return out << counted.value;
+}
+
 TEST_CASE("option types")
 {
     auto integer = aa::opt<int>("-i");
@@ -32,3 +167,1152 @@ TEST_CASE("option types")
     // TODO: add comparisons to Option?
     REQUIRE(*string == "abc");
 }
+
+TEST_CASE("malformed values")
+{
+    auto parser = aa::Parser{};
+    auto integer = parser.opt<int>("-i");
+    auto small = parser.opt<std::uint8_t>("-u");
+    auto real = parser.opt<double>("-d");
+    auto counted = parser.opt<Counted>("-c");
+    parser.printErrors(false);
+
+    parser.parse({"-i", "+12", "-u", "255", "-d", "-2.5e3", "-c", "7"});
+    REQUIRE(*integer == 12);
+    REQUIRE(*small == 255);
+    REQUIRE(*real == -2500);
+    REQUIRE(counted->value == 7);
+
+    const char* rejected[][2] = {
+        {"-i", "abc"}, {"-i", "12abc"}, {"-i", ""}, {"-i", " 1"},
+        {"-i", "99999999999"}, {"-u", "256"}, {"-u", "-1"}, {"-d", "1.5x"},
+        {"-d", "1e999"}, {"-c", "7 "}, {"-c", "x"},
+    };
+    for (const auto& args : rejected) {
+        auto strict = aa::Parser{};
+        strict.opt<int>("-i");
+        strict.opt<std::uint8_t>("-u");
+        strict.opt<double>("-d");
+        strict.opt<Counted>("-c");
+        strict.printErrors(false);
+        INFO(args[0] << " " << args[1]);
+        REQUIRE_THROWS_AS(strict.parse({args[0], args[1]}), aa::ParseError);
+    }
+}
+
+TEST_CASE("restrictions")
+{
+    auto parser = aa::Parser{};
+    auto all = parser.flag("-a", "--all");
+    auto none = parser.flag("-n", "--none");
+    auto input = parser.opt<std::string>("-i");
+    auto output = parser.opt<std::string>("-o");
+    auto verbose = parser.flag("-v");
+    parser.exclusive(all, none);
+    parser.atLeastOne(all, none, input);
+    parser.implies(output, input);
+    parser.occurrences(verbose, 0, 2);
+
+    SECTION("satisfied") {
+        parser.parse({"-a", "-i", "in", "-o", "out", "-vv"});
+        REQUIRE(all == 1);
+        REQUIRE(*output == "out");
+    }
+    SECTION("exclusive") {
+        REQUIRE_THROWS_AS(parser.parse({"-a", "--none"}), aa::Error);
+    }
+    SECTION("at least one") {
+        REQUIRE_THROWS_AS(parser.parse({"-v"}), aa::Error);
+    }
+    SECTION("implies") {
+        REQUIRE_THROWS_AS(parser.parse({"-a", "-o", "out"}), aa::Error);
+    }
+    SECTION("occurrences") {
+        REQUIRE_THROWS_AS(parser.parse({"-a", "-vvv"}), aa::Error);
+    }
+}
+
+TEST_CASE("environment")
+{
+    setEnv("AA_TEST_PORT", "8080");
+    setEnv("AA_TEST_HOST", "example.com");
+
+    auto parser = aa::Parser{};
+    auto port = parser.opt<int>("--port").env("AA_TEST_PORT").required();
+    auto host = parser.opt<std::string>("--host").env("AA_TEST_HOST");
+    auto user = parser.opt<std::string>("--user").env("AA_TEST_UNSET_USER");
+    parser.parse({"--host", "localhost"});
+
+    REQUIRE(port == 8080);
+    REQUIRE(host.all() == std::vector<std::string>{"localhost"});
+    REQUIRE(user.all().empty());
+
+    // Options that read the same variable all get its value.
+    auto shared = aa::Parser{};
+    auto listen = shared.opt<int>("--listen").env("AA_TEST_PORT");
+    auto advertise = shared.opt<std::string>("--advertise")
+        .env("AA_TEST_PORT");
+    shared.parse(std::vector<std::string>{});
+    REQUIRE(listen == 8080);
+    REQUIRE(*advertise == "8080");
+
+    REQUIRE_THROWS_AS(shared.opt<int>("--listen"), aa::Error);
+    REQUIRE_THROWS_AS(shared.flag("-x", "-x"), aa::Error);
+}
+
+TEST_CASE("config files")
+{
+    TempDir temp;
+    {
+        auto system = std::ofstream{temp.path("system.conf")};
+        system << "# system defaults\n"
+            "port = 80\n"
+            "host = 'example.com' ; comment\n"
+            "verbose = true\n"
+            "\n"
+            "[log]\n"
+            "level = 2 # comment\n";
+        auto user = std::ofstream{temp.path("user.conf")};
+        user << "port = 8080\r\n"
+            "name = \"a \\\"quoted\\\" name\" # note\r\n";
+    }
+
+    auto parser = aa::Parser{};
+    auto port = parser.opt<int>("--port");
+    auto host = parser.opt<std::string>("--host");
+    auto name = parser.opt<std::string>("--name");
+    auto level = parser.opt<int>("--log.level");
+    auto verbose = parser.flag("-v", "--verbose");
+    parser.configFile(temp.path("system.conf"));
+    parser.configFile(temp.path("user.conf"));
+    parser.configFile(temp.path("missing.conf"));
+    parser.parse({"--host", "localhost"});
+
+    REQUIRE(port == 8080);
+    REQUIRE(*host == "localhost");
+    REQUIRE(*name == "a \"quoted\" name");
+    REQUIRE(level == 2);
+    REQUIRE(verbose == 1);
+
+    SECTION("layered files count as one occurrence") {
+        std::ofstream{temp.path("app.conf")} << "port = 80\n";
+        std::ofstream{temp.path("apprc")} << "port = 8080\n";
+        auto layered = aa::Parser{};
+        auto layeredPort = layered.opt<int>("--port");
+        layered.occurrences(layeredPort, 0, 1);
+        layered.configFile(temp.path("app.conf"));
+        layered.configFile(temp.path("apprc"));
+        layered.printErrors(false);
+        layered.parse(std::vector<std::string>{});
+        REQUIRE(layeredPort == 8080);
+
+        auto overridden = aa::Parser{};
+        auto overriddenPort = overridden.opt<int>("--port");
+        overridden.occurrences(overriddenPort, 0, 1);
+        overridden.configFile(temp.path("app.conf"));
+        overridden.printErrors(false);
+        overridden.parse({"--port", "1"});
+        REQUIRE(overriddenPort.all() == std::vector<int>{1});
+    }
+}
+
+TEST_CASE("config file reloading")
+{
+    TempDir temp;
+    auto path = temp.path("reload.conf");
+    {
+        auto file = std::ofstream{path};
+        file << "port = 80\nhost = example.com\n";
+    }
+
+    auto parser = aa::Parser{};
+    auto port = parser.opt<int>("--port");
+    auto host = parser.opt<std::string>("--host");
+    parser.configFile(path);
+    parser.printErrors(false);
+    parser.parse({"--host", "localhost"});
+    REQUIRE(port == 80);
+    auto first = port.pinned();
+    const int* held = nullptr;
+
+    for (int value : {8080, 8081, 8082}) {
+        auto file = std::ofstream{path};
+        file << "port = " << value << "\nhost = example.org\n";
+        file.close();
+        parser.reloadConfigFiles();
+        REQUIRE(port == value);
+        if (held == nullptr) {
+            held = &*port;
+        }
+    }
+    REQUIRE(*host == "localhost");
+    REQUIRE(first->back() == 80);
+    // References into reloaded values stay valid.
+    REQUIRE(*held == 8080);
+
+    // Reloading values that did not change keeps the snapshot.
+    const auto& latest = *port;
+    parser.reloadConfigFiles();
+    parser.reloadConfigFiles();
+    REQUIRE(&*port == &latest);
+
+    {
+        auto file = std::ofstream{path};
+        file << "port = 1\nport\n";
+    }
+    parser.reloadConfigFiles();
+    REQUIRE(port == 8082);
+}
+
+TEST_CASE("snapshots")
+{
+    auto declare = [] (aa::Parser& parser) {
+        parser.flag("-v");
+        parser.opt<int>("-n");
+        parser.opt<double>("-x");
+        parser.opt<std::string>("-s");
+    };
+
+    auto source = aa::Parser{};
+    declare(source);
+    source.parse({"-vv", "-n", "1", "-n", "2", "-x", "0.5", "-s", "a b"});
+    auto snapshot = source.snapshot();
+
+    auto target = aa::Parser{};
+    auto verbose = target.flag("-v");
+    auto numbers = target.opt<int>("-n");
+    auto real = target.opt<double>("-x");
+    auto string = target.opt<std::string>("-s");
+    target.restore(snapshot);
+
+    REQUIRE(verbose == 2);
+    REQUIRE(numbers.all() == std::vector<int>{1, 2});
+    REQUIRE(real == 0.5);
+    REQUIRE(*string == "a b");
+
+    auto other = aa::Parser{};
+    other.opt<float>("-n");
+    REQUIRE_THROWS_AS(other.restore(snapshot), aa::Error);
+    REQUIRE_THROWS_AS(
+        target.restore(snapshot.substr(0, snapshot.size() - 1)), aa::Error);
+    REQUIRE_THROWS_AS(target.restore(snapshot + '\0'), aa::Error);
+
+    auto empty = aa::Parser{};
+    empty.flag("-v");
+    empty.opt<int>("-n");
+    empty.opt<double>("-x");
+    empty.opt<std::string>("-s");
+    empty.parse({"-n", "3"});
+    auto emptySnapshot = empty.snapshot();
+    REQUIRE_THROWS_AS(target.restore(emptySnapshot.substr(
+        0, emptySnapshot.size() - 1)), aa::Error);
+    REQUIRE(verbose == 2);
+    REQUIRE(numbers.all() == std::vector<int>{1, 2});
+    REQUIRE(*string == "a b");
+}
+
+TEST_CASE("rendering argv")
+{
+    auto parser = aa::Parser{};
+    auto verbose = parser.flag("-v");
+    auto quiet = parser.flag("-q", "--quiet");
+    auto port = parser.opt<int>("-p", "--port");
+    auto ratio = parser.opt<double>("-r");
+    auto name = parser.opt<std::string>("-n").init("default");
+    parser.programName("program");
+    parser.parse({"-vv", "--port", "80", "-r", "0.25", "input", "--", "-x"});
+
+    auto rendered = parser.argv(aa::Overrides{}.set(port, 8080).set(quiet, 1));
+    auto args = std::vector<std::string>(
+        rendered.argv(), rendered.argv() + rendered.argc());
+    REQUIRE(rendered.argv()[rendered.argc()] == nullptr);
+    REQUIRE(args == std::vector<std::string>{
+        "program", "-vv", "--quiet", "--port=8080", "-r", "0.25",
+        "--", "input", "-x"});
+
+    auto reparsed = aa::Parser{};
+    auto reverbose = reparsed.flag("-v");
+    reparsed.flag("-q", "--quiet");
+    auto report = reparsed.opt<int>("-p", "--port");
+    auto reratio = reparsed.opt<double>("-r");
+    reparsed.parse(rendered.argc(), rendered.argv());
+    REQUIRE(reverbose == verbose);
+    REQUIRE(report == 8080);
+    REQUIRE(reratio == ratio);
+    REQUIRE(*name == "default");
+}
+
+TEST_CASE("events")
+{
+    auto parser = aa::Parser{};
+    auto verbose = parser.flag("-v");
+    auto include = parser.opt<std::string>("-I", "--include");
+    auto events = std::vector<aa::Event>{};
+    auto values = std::vector<std::string>{};
+    parser.listen([&] (const aa::Event& event) {
+        events.push_back(event);
+        values.push_back(event.value.str());
+    });
+    parser.parse({"-vIa", "--include=b", "x", "-I", "c"});
+
+    REQUIRE(events.size() == 5);
+    REQUIRE(events[0].option == verbose.id());
+    REQUIRE(events[1].option == include.id());
+    REQUIRE(events[3].kind == aa::Event::Positional);
+    REQUIRE(events[4].argument == 3);
+    REQUIRE(values == std::vector<std::string>{"", "a", "b", "x", "c"});
+    REQUIRE(verbose == 1);
+    REQUIRE(include.all().empty());
+}
+
+TEST_CASE("diagnostics")
+{
+    auto parser = aa::Parser{};
+    auto verbose = parser.flag("-v");
+    parser.opt<aa::bytes>("--size");
+    parser.occurrences(verbose, 0, 1);
+    parser.printErrors(false);
+
+    try {
+        parser.parse({"-vv", "--size=big", "-x"});
+        FAIL("parse() should have thrown");
+    } catch (const aa::ParseError& error) {
+        const auto& diagnostics = error.diagnostics();
+        REQUIRE(diagnostics.size() == 3);
+        REQUIRE(diagnostics[0].code == aa::ErrorCode::InvalidValue);
+        REQUIRE(diagnostics[0].text == "big");
+        REQUIRE(diagnostics[1].message() == "unknown option: -x in -x");
+        REQUIRE(diagnostics[2].code == aa::ErrorCode::TooMany);
+        REQUIRE(diagnostics[2].message() ==
+            "option -v must be given at most 1 times");
+
+        auto what = std::string{error.what()};
+        REQUIRE(what.find("parsing failed:\n") != std::string::npos);
+        REQUIRE(what.find("option --size: invalid value 'big'\n") !=
+            std::string::npos);
+    }
+}
+
+TEST_CASE("errors")
+{
+    auto file = std::string{"generated.cpp"};
+    auto function = std::string{"run"};
+    auto error = aa::Error{"failed", file, 7, function};
+    file.clear();
+    function.clear();
+    REQUIRE(std::string{error.what()} == "generated.cpp:7 (run): failed");
+
+    auto copy = error;
+    REQUIRE(std::string{copy.what()} == "generated.cpp:7 (run): failed");
+    REQUIRE(std::string{aa::Error{"failed", "a.cpp", 1, "f"}.what()} ==
+        "a.cpp:1 (f): failed");
+}
+
+TEST_CASE("value checks")
+{
+    auto parser = aa::Parser{};
+    auto port = parser.opt<int>("-p", "--port").range(1, 65535);
+    auto ratio = parser.opt<double>("--ratio").range(0, 1);
+    auto id = parser.opt<std::string>("--id").matches(aa::Pattern::Hex);
+    auto name = parser.opt<std::string>("--name")
+        .nonEmpty()
+        .matches(aa::Pattern::Identifier);
+    auto even = parser.opt<int>("-e").check(
+        [] (int value) { return value % 2 == 0; }, "must be even");
+    auto input = parser.opt<std::string>("-i").exists();
+    parser.printErrors(false);
+
+    parser.parse({"-p", "80", "--ratio=0.5", "--id", "c0ffee", "--name=x_1",
+        "-e4", "-i", "."});
+    REQUIRE(*port == 80);
+    REQUIRE(*id == "c0ffee");
+    REQUIRE(*even == 4);
+
+    SECTION("failures are reported with their arguments") {
+        try {
+            parser.parse({"-p0", "-p", "70000", "-p", "443", "--ratio=1.5",
+                "--id=xyz", "--name=", "-e3", "-i", "/no/such/path"});
+            FAIL("parse() should have thrown");
+        } catch (const aa::ParseError& error) {
+            auto messages = std::vector<std::string>{};
+            for (const auto& diagnostic : error.diagnostics()) {
+                messages.push_back(diagnostic.message());
+            }
+            auto expected = std::vector<std::string>{
+                "option -p,--port: value '0' in argument 1 "
+                    "must be between 1 and 65535",
+                "option -p,--port: value '70000' in argument 2 "
+                    "must be between 1 and 65535",
+                "option --ratio: value '1.5' in argument 6 "
+                    "must be between 0 and 1",
+                "option --id: value 'xyz' in argument 7 must be hexadecimal",
+                "option --name: value '' in argument 8 must not be empty",
+                "option --name: value '' in argument 8 "
+                    "must be an identifier",
+                "option -e: value '3' in argument 9 must be even",
+                "option -i: value '/no/such/path' in argument 10 "
+                    "must be an existing path",
+            };
+            REQUIRE(messages == expected);
+        }
+    }
+
+    SECTION("values converted in bulk keep their arguments") {
+        auto bulk = aa::Parser{};
+        auto values = bulk.opt<aa::duration>("-n").range(
+            aa::duration{0}, std::chrono::seconds{9});
+        bulk.parallelConversion(4, 2);
+        bulk.printErrors(false);
+
+        auto args = std::vector<std::string>{};
+        for (int i = 0; i < 20; i++) {
+            args.push_back(i == 12 ? "-nx" : i == 15 ? "-n10s" : "-n1s");
+        }
+        try {
+            bulk.parse(args);
+            FAIL("parse() should have thrown");
+        } catch (const aa::ParseError& error) {
+            const auto& diagnostics = error.diagnostics();
+            REQUIRE(diagnostics.size() == 2);
+            REQUIRE(diagnostics[0].code == aa::ErrorCode::InvalidValue);
+            REQUIRE(diagnostics[1].code == aa::ErrorCode::FailedCheckAt);
+            REQUIRE(diagnostics[1].text == "10s");
+            REQUIRE(diagnostics[1].number == 16);
+        }
+        REQUIRE(values.all().size() == 19);
+    }
+
+    SECTION("defaults are not checked") {
+        auto defaults = aa::Parser{};
+        auto level = defaults.opt<int>("--level").init(0).range(1, 3);
+        defaults.parse({});
+        REQUIRE(*level == 0);
+    }
+
+    SECTION("tracked command lines are checked on every edit") {
+        auto tracked = aa::Parser{};
+        tracked.opt<int>("-p", "--port").range(1, 65535);
+        REQUIRE(tracked.track({"-p", "80"}).empty());
+        REQUIRE(tracked.replaceArg(1, "0") ==
+            "option -p,--port: value '0' in argument 1 "
+            "must be between 1 and 65535\n");
+        REQUIRE(tracked.insertArg(0, "--port=0") ==
+            "option -p,--port: value '0' in argument 1 "
+            "must be between 1 and 65535\n"
+            "option -p,--port: value '0' in argument 2 "
+            "must be between 1 and 65535\n");
+        REQUIRE(tracked.eraseArg(1) ==
+            "option -p,--port: value '0' in argument 1 "
+            "must be between 1 and 65535\n");
+        REQUIRE(tracked.eraseArg(0).empty());
+    }
+
+    SECTION("tracked checks follow kept values and fallbacks") {
+        setEnv("AA_TEST_TRACKED_WIDTH", "0");
+        auto tracked = aa::Parser{};
+        tracked.opt<int>("-w").env("AA_TEST_TRACKED_WIDTH").range(1, 9);
+        tracked.opt<int>("-n").keepLast().range(1, 9);
+        REQUIRE(tracked.track({"-n0", "-n1"}) ==
+            "option -w: value '0' must be between 1 and 9\n");
+        REQUIRE(tracked.insertArg(0, "-w5").empty());
+        REQUIRE(tracked.insertArg(3, "-n10") ==
+            "option -n: value '10' in argument 4 must be between 1 and 9\n");
+        REQUIRE(tracked.eraseArg(3).empty());
+        REQUIRE(tracked.eraseArg(0) ==
+            "option -w: value '0' must be between 1 and 9\n");
+    }
+
+    SECTION("all values converted in bulk keep their arguments") {
+        auto bulk = aa::Parser{};
+        bulk.opt<int>("-p").range(1, 9);
+        bulk.parallelConversion(0, 2);
+        bulk.printErrors(false);
+        try {
+            bulk.parse({"-p0", "-p", "1"});
+            FAIL("parse() should have thrown");
+        } catch (const aa::ParseError& error) {
+            REQUIRE(error.diagnostics().size() == 1);
+            REQUIRE(error.diagnostics()[0].number == 1);
+        }
+    }
+}
+
+TEST_CASE("path options")
+{
+    TempDir temp;
+    auto input = temp.path("input.txt");
+    auto missing = temp.path("missing");
+    {
+        auto file = std::ofstream{input};
+        file << "input\n";
+    }
+
+    auto parser = aa::Parser{};
+    auto inputs = parser.opt<aa::path>("-i").readable(aa::PathType::File);
+    auto dir = parser.opt<aa::path>("-d").exists(aa::PathType::Directory);
+    parser.printErrors(false);
+
+    // More values than the ring has entries, so that it is refilled.
+    auto args = std::vector<std::string>{"-d", "."};
+    for (int i = 0; i < 600; i++) {
+        args.push_back("-i");
+        args.push_back(i % 200 == 7 ? missing : input);
+    }
+    args.push_back("-i.");
+    try {
+        parser.parse(args);
+        FAIL("parse() should have thrown");
+    } catch (const aa::ParseError& error) {
+        auto messages = std::vector<std::string>{};
+        for (const auto& diagnostic : error.diagnostics()) {
+            messages.push_back(diagnostic.message());
+        }
+        auto expected = std::vector<std::string>{};
+        for (int argument : {17, 417, 817}) {
+            expected.push_back("option -i: value '" + missing +
+                "' in argument " + std::to_string(argument) +
+                " must be a readable file");
+        }
+        expected.push_back(
+            "option -i: value '.' in argument 1203 must be a readable file");
+        REQUIRE(messages == expected);
+    }
+    REQUIRE(inputs.all().size() == 601);
+    REQUIRE(inputs->name == ".");
+    REQUIRE(static_cast<const std::string&>(*dir) == ".");
+
+    SECTION("the ring and threads agree") {
+        // Enough paths for a ring, where the system has one.
+        auto names = std::vector<const char*>{};
+        while (names.size() < aa::internal::minRingBatch) {
+            for (auto name : {".", input.c_str(), missing.c_str(), "", "/"}) {
+                names.push_back(name);
+            }
+        }
+        auto n = names.size();
+        auto batched = std::vector<aa::internal::FileStatus>(n);
+        auto threaded = std::vector<aa::internal::FileStatus>(n);
+        aa::internal::statPaths(names.data(), n, batched.data());
+        aa::internal::statPathsOnThreads(names.data(), n, threaded.data());
+        for (size_t i = 0; i < n; i++) {
+            REQUIRE(batched[i].found == threaded[i].found);
+            REQUIRE(batched[i].mode == threaded[i].mode);
+            REQUIRE(batched[i].uid == threaded[i].uid);
+        }
+        REQUIRE(batched[1].found);
+        REQUIRE(!batched[2].found);
+    }
+
+#if defined(AA_HAS_IO_URING)
+    SECTION("a failing ring waits for the requests it submitted") {
+        auto names = std::vector<const char*>(600, input.c_str());
+        auto statuses = std::vector<aa::internal::FileStatus>(names.size());
+        aa::internal::StatRing ring{256};
+        auto calls = 0;
+        auto failing = [&] (unsigned submit) -> long {
+            if (calls++ > 0) {
+                errno = EIO;
+                return -1;
+            }
+            return ring.enter(submit);
+        };
+        if (ring.ready()) {
+            REQUIRE(!ring.run(
+                names.data(), names.size(), statuses.data(), failing));
+            REQUIRE(ring.inFlight() == 0);
+        }
+    }
+#endif
+
+    SECTION("empty paths are rejected") {
+        auto empty = aa::Parser{};
+        empty.opt<aa::path>("-p");
+        empty.printErrors(false);
+        REQUIRE_THROWS_AS(empty.parse({"-p", ""}), aa::ParseError);
+    }
+}
+
+#if !defined(_WIN32)
+TEST_CASE("glob expansion")
+{
+    TempDir temp;
+    auto at = [&] (const char* name) {
+        return temp.path(name);
+    };
+    const char* directories[] = {"sub", "sub/deep", ".hidden"};
+    const char* files[] = {
+        "a.gz", "b.gz", "c.txt", ".d.gz", "sub/e.gz", "sub/deep/f.gz",
+        ".hidden/g.gz", "[x].gz"};
+    for (auto directory : directories) {
+        mkdir(at(directory).c_str(), 0755);
+    }
+    for (auto file : files) {
+        std::ofstream{at(file)} << "x";
+    }
+
+    auto parser = aa::Parser{};
+    auto inputs = parser.opt<aa::path>("-i").exists();
+    auto names = parser.opt<std::string>("-n");
+    parser.expandGlobs(true, 4);
+    parser.printErrors(false);
+
+    auto all = [&] () {
+        auto result = std::vector<std::string>{};
+        for (const auto& input : inputs.all()) {
+            result.push_back(input.name);
+        }
+        return result;
+    };
+
+    SECTION("option values") {
+        parser.parse({"-i", at("*.gz"), "-n*.gz", "-i" + at("sub/*.gz"), "-i",
+            at("[ab].gz")});
+        REQUIRE(all() == (std::vector<std::string>{
+            at("[x].gz"), at("a.gz"), at("b.gz"), at("sub/e.gz")}));
+        REQUIRE(*names == "*.gz");
+    }
+
+    SECTION("any depth") {
+        parser.parse({"-i", at("**/*.gz"), "-i", at("*/")});
+        REQUIRE(all() == (std::vector<std::string>{
+            at("[x].gz"), at("a.gz"), at("b.gz"), at("sub/deep/f.gz"),
+            at("sub/e.gz"), at("sub/")}));
+    }
+
+    SECTION("hidden names and escapes") {
+        parser.parse({"-i", at(".*.gz"), "-i", at("\\[x\\]*.gz"), "-i",
+            at("[!a-b].*")});
+        REQUIRE(all() == (std::vector<std::string>{
+            at(".d.gz"), at("[x].gz"), at("c.txt")}));
+    }
+
+    SECTION("positional arguments") {
+        auto positionals = std::vector<std::string>{};
+        parser.listen([&] (const aa::Event& event) {
+            if (event.kind == aa::Event::Positional) {
+                positionals.push_back(event.value.str());
+            }
+        });
+        parser.parse(
+            {at("sub/*/*.gz"), at("?.txt"), at("sub/*/*.gz"), "plain"});
+        REQUIRE(positionals == (std::vector<std::string>{
+            at("sub/deep/f.gz"), at("c.txt"), "plain"}));
+    }
+
+    SECTION("patterns that match nothing are kept") {
+        REQUIRE_THROWS_AS(parser.parse({"-i", at("*.zip")}), aa::ParseError);
+        REQUIRE(all() == (std::vector<std::string>{at("*.zip")}));
+    }
+
+    SECTION("escapes are removed from values kept as they are") {
+        parser.parse({"-i", at("\\[x].gz"), "-n", "\\*.gz"});
+        REQUIRE(all() == (std::vector<std::string>{at("[x].gz")}));
+        REQUIRE(*names == "\\*.gz");
+        REQUIRE_THROWS_AS(
+            parser.parse({"-i", at("\\a*.zip")}), aa::ParseError);
+        REQUIRE(all().back() == at("a*.zip"));
+    }
+
+    SECTION("expansion is off by default") {
+        auto plain = aa::Parser{};
+        auto values = plain.opt<aa::path>("-i");
+        plain.parse({"-i", at("*.gz")});
+        REQUIRE(values->name == at("*.gz"));
+    }
+}
+#endif
+
+TEST_CASE("missing option value")
+{
+    auto parser = aa::Parser{};
+    parser.opt<int>("-n");
+    REQUIRE_THROWS_AS(parser.parse({"-n"}), aa::Error);
+}
+
+TEST_CASE("incremental parsing")
+{
+    setEnv("AA_TEST_TRACKED_LEVEL", "3");
+
+    auto declare = [] (aa::Parser& parser) {
+        auto verbose = parser.flag("-v", "--verbose");
+        auto level = parser.opt<int>("-l", "--level")
+            .env("AA_TEST_TRACKED_LEVEL");
+        parser.opt<std::string>("-n", "--name").keepLast();
+        parser.opt<aa::bytes>("-s", "--size");
+        auto input = parser.opt<std::string>("-i", "--input").required();
+        parser.implies(verbose, level);
+        return input;
+    };
+    auto render = [] (const aa::Parser& parser) {
+        auto args = parser.argv();
+        return std::vector<std::string>(args.argv(), args.argv() + args.argc());
+    };
+
+    auto parser = aa::Parser{};
+    auto input = declare(parser);
+    REQUIRE(parser.track({"-i", "a", "-v"}).empty());
+    REQUIRE(*input == "a");
+
+    auto errors = parser.replaceArg(0, "-s");
+    REQUIRE(errors.find("invalid value 'a'") != std::string::npos);
+    REQUIRE(errors.find("is required") != std::string::npos);
+    REQUIRE(parser.replaceArg(0, "--input").empty());
+    REQUIRE(parser.insertArg(3, "-l") ==
+        "option -l,--level requires a value\n");
+    REQUIRE(parser.insertArg(4, "7").empty());
+    REQUIRE(parser.insertArg(0, "x").empty());
+    REQUIRE(render(parser) == std::vector<std::string>{
+        "PROGRAM", "--verbose", "--level=7", "--input=a", "x"});
+
+    // Every edit leaves the same state as tracking the edited command line
+    // from scratch, and as parsing it when it is valid.
+    const char* pool[] = {
+        "-v", "-vl", "-l", "5", "--level=9", "-n", "n1", "--name=n2", "-i",
+        "in", "--input", "--", "pos", "-x", "--level", "-lz", "-s", "4k",
+        "huge", "--size=1M",
+    };
+    const size_t poolSize = sizeof(pool) / sizeof(pool[0]);
+    auto args = std::vector<std::string>{};
+    std::uint32_t random = 12345;
+    auto next = [&random] (std::uint32_t n) {
+        random = random * 1103515245 + 12345;
+        return (random >> 16) % n;
+    };
+
+    auto tracked = aa::Parser{};
+    declare(tracked);
+    tracked.track(args);
+    for (int step = 0; step < 400; step++) {
+        auto size = static_cast<std::uint32_t>(args.size());
+        auto kind = size == 0 ? 0 : next(3);
+        auto text = std::string{pool[next(poolSize)]};
+        auto errors = std::string{};
+        if (kind == 0) {
+            auto at = next(size + 1);
+            args.insert(args.begin() + at, text);
+            errors = tracked.insertArg(at, text);
+        } else if (kind == 1) {
+            auto at = next(size);
+            args[at] = text;
+            errors = tracked.replaceArg(at, text);
+        } else {
+            auto at = next(size);
+            args.erase(args.begin() + at);
+            errors = tracked.eraseArg(at);
+        }
+
+        auto fresh = aa::Parser{};
+        declare(fresh);
+        REQUIRE(fresh.track(args) == errors);
+        REQUIRE(render(fresh) == render(tracked));
+        if (errors.empty()) {
+            auto parsed = aa::Parser{};
+            declare(parsed);
+            parsed.parse(args);
+            REQUIRE(render(parsed) == render(tracked));
+        }
+    }
+
+    // Each value is converted once, when the argument holding it is read.
+    auto counting = aa::Parser{};
+    auto counted = counting.opt<Counted>("-c");
+    Counted::conversions = 0;
+    REQUIRE(counting.track({"-c", "1", "-c2"}).empty());
+    REQUIRE(Counted::conversions == 2);
+    REQUIRE(counting.replaceArg(1, "3").empty());
+    REQUIRE(counting.insertArg(0, "-c4").empty());
+    REQUIRE(Counted::conversions == 4);
+    REQUIRE(counted.all().size() == 3);
+    REQUIRE(counted.all()[0].value == 4);
+    REQUIRE(counted.all()[1].value == 3);
+    REQUIRE(counted.all()[2].value == 2);
+}
+
+#if defined(AA_HAS_COROUTINES)
+TEST_CASE("streaming arguments")
+{
+    auto parser = aa::Parser{};
+    auto verbose = parser.flag("-v");
+    auto include = parser.opt<std::string>("-I");
+
+    const char data[] = "-v\0-I\0a b\0file\0";
+    auto input = std::istringstream{std::string{data, sizeof(data) - 1}};
+    auto values = std::vector<std::string>{};
+    for (const auto& event : parser.stream(input)) {
+        if (event.kind == aa::Event::Option && event.option == include.id()) {
+            values.push_back(event.value.str());
+        } else if (event.kind == aa::Event::Positional) {
+            values.push_back(event.value.str());
+        }
+    }
+
+    REQUIRE(verbose == 1);
+    REQUIRE(values == std::vector<std::string>{"a b", "file"});
+}
+#endif
+
+TEST_CASE("arguments from files")
+{
+    TempDir temp;
+    auto text = temp.path("args.txt");
+    auto binary = temp.path("args.bin");
+    {
+        auto lines = std::ofstream{text};
+        lines << "-n\n5\n\nfirst file\n";
+        auto nul = std::ofstream{binary, std::ios::binary};
+        const char data[] = "-v\0second\nfile\0";
+        nul.write(data, sizeof(data) - 1);
+    }
+
+    auto parser = aa::Parser{};
+    auto number = parser.opt<int>("-n");
+    auto verbose = parser.flag("-v");
+    auto positionals = std::vector<std::string>{};
+    parser.argsFrom();
+    parser.listen([&] (const aa::Event& event) {
+        if (event.kind == aa::Event::Positional) {
+            positionals.push_back(event.value.str());
+        }
+    });
+    parser.parse({"--args-from", text, "-0", "--args-from=" + binary, "last"});
+
+    REQUIRE(number.all().empty());
+    REQUIRE(verbose == 1);
+    REQUIRE(positionals == std::vector<std::string>{
+        "first file", "second\nfile", "last"});
+}
+
+TEST_CASE("parallel conversion")
+{
+    TempDir temp;
+    auto ids = temp.path("ids.txt");
+    {
+        auto lines = std::ofstream{ids};
+        for (int i = 3000; i < 3100; i++) {
+            lines << "--id\n" << i << "\n";
+        }
+    }
+
+    auto args = std::vector<std::string>{};
+    auto expected = std::vector<int>{};
+    for (int i = 0; i < 3000; i++) {
+        args.push_back("--id=" + std::to_string(i));
+        expected.push_back(i);
+        if (i == 1500) {
+            args.push_back("--args-from=" + ids);
+            for (int j = 3000; j < 3100; j++) {
+                expected.push_back(j);
+            }
+        }
+    }
+
+    auto parser = aa::Parser{};
+    auto id = parser.opt<int>("--id");
+    auto name = parser.opt<std::string>("--name").keepLast();
+    parser.argsFrom();
+    parser.parallelConversion(10, 4);
+    parser.parse(args);
+    REQUIRE(id.all() == expected);
+    REQUIRE(name.all().empty());
+
+    auto sizes = aa::Parser{};
+    auto size = sizes.opt<aa::bytes>("--size");
+    sizes.parallelConversion(2, 3);
+    args.clear();
+    for (int i = 0; i < 10; i++) {
+        args.push_back("--size=" + std::to_string(i) + (i == 7 ? "X" : "k"));
+    }
+    REQUIRE_THROWS_AS(sizes.parse(args), aa::Error);
+    REQUIRE(size.all().size() == 9);
+    REQUIRE(size.all()[7].count == 8000);
+
+    // Off by default: a rejected value is reported where it was read, before
+    // the problems found after it.
+    auto sequential = aa::Parser{};
+    sequential.opt<aa::bytes>("--size");
+    sequential.printErrors(false);
+    args.assign(5000, "--size=1k");
+    args[10] = "--size=x";
+    args.push_back("--bogus");
+    try {
+        sequential.parse(args);
+        FAIL("parse() should have thrown");
+    } catch (const aa::ParseError& error) {
+        REQUIRE(error.diagnostics().size() == 2);
+        REQUIRE(error.diagnostics()[0].code == aa::ErrorCode::InvalidValue);
+    }
+}
+
+TEST_CASE("value storage")
+{
+    auto strings = aa::SmallVector<std::string, 1>{};
+    strings.push_back("first, long enough to allocate on its own");
+    REQUIRE(strings.capacity() == 1);
+    for (int i = 0; i < 10; i++) {
+        strings.push_back(strings.front());
+    }
+    REQUIRE(strings.size() == 11);
+    REQUIRE(strings.back() == strings.front());
+
+    auto moved = std::move(strings);
+    REQUIRE(strings.empty());
+    REQUIRE(moved.size() == 11);
+    auto inlined = aa::SmallVector<std::string, 1>{"one"};
+    strings = inlined;
+    moved = std::move(inlined);
+    REQUIRE(moved == std::vector<std::string>{"one"});
+    REQUIRE(strings == moved);
+    static_assert(
+        std::is_nothrow_move_constructible<aa::Values<std::string>>::value &&
+        std::is_nothrow_move_assignable<aa::Values<std::string>>::value,
+        "values are moved, not copied, when a vector of them grows");
+
+    auto parser = aa::Parser{};
+    auto level = parser.opt<int>("-l").keepLast().init(1);
+    auto tags = parser.opt<int>("-t");
+    parser.parse({"-l", "2", "-l", "3", "-t", "1", "-t", "2"});
+    REQUIRE(level.all() == std::vector<int>{3});
+    REQUIRE(level.all().capacity() == aa::Values<int>{}.capacity());
+    REQUIRE(tags.all() == std::vector<int>{1, 2});
+}
+
+TEST_CASE("unit values")
+{
+    auto parser = aa::Parser{};
+    auto cache = parser.opt<aa::bytes>("--cache-size");
+    auto timeout = parser.opt<aa::duration>("--timeout");
+    auto interval = parser.opt<std::chrono::seconds>("--interval");
+    auto limit = parser.opt<aa::rate>("--rate");
+    parser.parse({
+        "--cache-size=4GiB", "--cache-size=1.5k", "--cache-size=64",
+        "--timeout=250ms", "--timeout=1h30m", "--interval=2m",
+        "--rate=10k/s", "--rate=3/ms"});
+
+    REQUIRE(cache.all()[0] == 4ull << 30);
+    REQUIRE(cache.all()[1] == 1500);
+    REQUIRE(cache.all()[2] == 64);
+    REQUIRE(timeout.all()[0] == std::chrono::milliseconds{250});
+    REQUIRE(timeout.all()[1] == std::chrono::minutes{90});
+    REQUIRE(interval->count() == 120);
+    REQUIRE(limit.all()[0] == 10000.0);
+    REQUIRE(limit.all()[1] == 3000.0);
+
+    auto args = parser.argv();
+    REQUIRE(std::string(args.argv()[4]) == "--timeout=250ms");
+    REQUIRE(std::string(args.argv()[5]) == "--timeout=90min");
+
+    for (const char* bad : {
+            "--cache-size=16EiB", "--cache-size=18446744073709551616",
+            "--cache-size=4GiBs", "--timeout=300y", "--timeout=1",
+            "--timeout=107000d", "--interval=1500ms", "--rate=10k/fortnight"}) {
+        REQUIRE_THROWS_AS(parser.parse({bad}), aa::Error);
+    }
+}
+
+enum class Mode { Fast, Safe, Debug };
+
+TEST_CASE("choices")
+{
+    auto parser = aa::Parser{};
+    auto mode = parser.opt<Mode>("--mode").choices({
+        {"fast", Mode::Fast}, {"safe", Mode::Safe}, {"debug", Mode::Debug},
+    });
+    auto level = parser.opt<Mode>("--level");
+    parser.parse({"--mode", "debug", "--level=1"});
+    REQUIRE((*mode == Mode::Debug));
+    REQUIRE((*level == Mode::Safe));
+
+    auto args = parser.argv();
+    REQUIRE(std::string(args.argv()[1]) == "--mode=debug");
+    REQUIRE(std::string(args.argv()[2]) == "--level=1");
+
+    auto help = std::ostringstream{};
+    parser.printHelp(help);
+    REQUIRE(help.str().find("[choices: fast|safe|debug]") != std::string::npos);
+
+    REQUIRE_THROWS_AS(parser.parse({"--mode", "turbo"}), aa::Error);
+
+    auto codecs = std::vector<std::pair<std::string, int>>{};
+    for (int i = 0; i < 60; i++) {
+        codecs.emplace_back("codec" + std::to_string(i), i);
+    }
+    auto table = aa::internal::ChoiceTable<int>{codecs};
+    for (const auto& codec : codecs) {
+        auto found = table.find(codec.first.data(), codec.first.size());
+        REQUIRE(found != nullptr);
+        REQUIRE(*found == codec.second);
+    }
+    REQUIRE(table.find("codec60", 7) == nullptr);
+}
+
+TEST_CASE("packed flags")
+{
+    static_assert(
+        sizeof(aa::Flag) <= 2 * sizeof(void*),
+        "flags are a block pointer and a bit");
+
+    auto parser = aa::Parser{};
+    auto flags = std::vector<aa::Flag>{};
+    for (int i = 0; i < 100; i++) {
+        flags.push_back(parser.flag("--flag" + std::to_string(i)));
+    }
+    auto verbose = parser.flag("-v");
+    parser.parse({"--flag3", "--flag70", "--flag70", "-vvv"});
+
+    REQUIRE(flags[3]);
+    REQUIRE(!flags[4]);
+    REQUIRE(flags[70] == 2);
+    REQUIRE(verbose == 3);
+    REQUIRE(verbose.id() == 100);
+
+    SECTION("counts are exact") {
+        auto counted = aa::Parser{};
+        auto debug = counted.flag("-d");
+        counted.parse(std::vector<std::string>(300, "-d"));
+        REQUIRE(debug == 300);
+    }
+
+    SECTION("flags outlive their parser") {
+        auto kept = aa::Flag{};
+        {
+            auto scoped = aa::Parser{};
+            kept = scoped.flag("-q");
+            scoped.parse({"-qq"});
+        }
+        REQUIRE(kept == 2);
+        REQUIRE(kept);
+    }
+}
+
+AA_CONSTINIT aa::StaticOption<int> staticPort =
+    aa::StaticOption<int>{"-p", "--port"}.metavar("PORT").init("8080");
+AA_CONSTINIT aa::StaticOption<std::string> staticName{"--name"};
+AA_CONSTINIT aa::StaticFlag staticVerbose{"-v"};
+
+TEST_CASE("static options")
+{
+    static_assert(
+        std::is_trivially_destructible<aa::StaticOption<int>>::value,
+        "static options must not need destructors");
+    REQUIRE(staticVerbose == 0);
+    REQUIRE_THROWS_AS(*staticPort, aa::Error);
+
+    {
+        auto parser = aa::Parser{};
+        parser.declare(staticPort, staticName, staticVerbose);
+        REQUIRE(staticPort == 8080);
+
+        parser.parse({"-vv", "--name", "some name", "-p", "1"});
+        REQUIRE(staticPort == 1);
+        REQUIRE(*staticName == "some name");
+        REQUIRE(staticVerbose == 2);
+
+        auto other = aa::Parser{};
+        REQUIRE_THROWS_AS(other.declare(staticPort), aa::Error);
+        REQUIRE_THROWS_AS(other.declare(staticVerbose), aa::Error);
+    }
+
+    // Declarations go away with their parser.
+    REQUIRE(staticVerbose == 0);
+    REQUIRE_THROWS_AS(*staticPort, aa::Error);
+
+    auto parser = aa::Parser{};
+    parser.declare(staticPort, staticVerbose);
+    parser.parse({"-v"});
+    REQUIRE(staticPort == 8080);
+    REQUIRE(staticVerbose == 1);
+}
+
+struct BoundConfig {
+    int port = 8080;
+    std::string host;
+    bool verbose = false;
+    std::vector<int> ids;
+    double ratio = 0;
+};
+
+TEST_CASE("struct binding")
+{
+    auto config = BoundConfig{};
+    auto parser = aa::Parser{};
+    parser.bind(config)
+        .field(&BoundConfig::port, "-p", "--port").help("port to listen on")
+        .field(&BoundConfig::host, "--host").required()
+        .field(&BoundConfig::verbose, "-v", "--verbose")
+        .field(&BoundConfig::ids, "--id")
+        .field(&BoundConfig::ratio, "--ratio");
+    parser.parse({
+        "--host", "localhost", "-p", "1", "--port=2", "--id=3", "--id=4",
+        "--ratio=0.5"});
+
+    REQUIRE(config.port == 2);
+    REQUIRE(config.host == "localhost");
+    REQUIRE_FALSE(config.verbose);
+    REQUIRE(config.ids == std::vector<int>{3, 4});
+    REQUIRE(config.ratio == 0.5);
+
+    auto args = parser.argv();
+    REQUIRE(args.argc() == 6);
+    REQUIRE(std::string(args.argv()[1]) == "--port=2");
+
+    auto snapshot = parser.snapshot();
+    auto restored = BoundConfig{};
+    auto other = aa::Parser{};
+    other.bind(restored)
+        .field(&BoundConfig::port, "-p", "--port")
+        .field(&BoundConfig::host, "--host")
+        .field(&BoundConfig::verbose, "-v", "--verbose")
+        .field(&BoundConfig::ids, "--id")
+        .field(&BoundConfig::ratio, "--ratio");
+    other.restore(snapshot);
+    REQUIRE(restored.port == 2);
+    REQUIRE(restored.ids == config.ids);
+
+    auto edited = BoundConfig{};
+    auto tracked = aa::Parser{};
+    tracked.bind(edited)
+        .field(&BoundConfig::port, "-p")
+        .field(&BoundConfig::verbose, "-v")
+        .field(&BoundConfig::ids, "--id");
+    REQUIRE(tracked.track({"-v", "-p", "1", "--id=5"}).empty());
+    REQUIRE(edited.verbose);
+    REQUIRE(tracked.eraseArg(0).empty());
+    REQUIRE_FALSE(edited.verbose);
+    REQUIRE(tracked.replaceArg(1, "7").empty());
+    REQUIRE(edited.port == 7);
+    REQUIRE(tracked.eraseArg(0).empty());
+    REQUIRE(edited.port == 8080);
+    REQUIRE(tracked.insertArg(0, "--id=4").empty());
+    REQUIRE(edited.ids == std::vector<int>{4, 5});
+    // Flags take no value, so there is nothing to read from a variable.
+    auto flags = aa::Parser{};
+    REQUIRE_THROWS_AS(
+        flags.bind(edited).field(&BoundConfig::verbose, "-v").env("VERBOSE"),
+        aa::Error);
+}
+
+TEST_CASE("stats")
+{
+    auto parser = aa::Parser{};
+    parser.flag("-a");
+    parser.flag("-b");
+    parser.opt<int>("--number");
+    parser.parse({"-ab", "--number", "1", "--number=2", "x"});
+
+    auto stats = parser.stats();
+#if defined(AA_STATS)
+    REQUIRE(stats.enabled);
+#endif
+    if (!stats.enabled) {
+        REQUIRE(stats.tokens == 0);
+        return;
+    }
+    REQUIRE(stats.tokens == 5);
+    REQUIRE(stats.longOptions == 2);
+    REQUIRE(stats.shortOptions == 2);
+    REQUIRE(stats.bundledOptions == 1);
+    REQUIRE(stats.positionals == 1);
+    REQUIRE(stats.conversions.size() == 1);
+    REQUIRE(stats.conversions.front().count == 2);
+    REQUIRE(stats.parseTime.count() > 0);
+}